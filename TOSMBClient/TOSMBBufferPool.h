@@ -0,0 +1,63 @@
+//
+// TOSMBBufferPool.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBBufferPool_h
+#define TOSMBBufferPool_h
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A thread-safe pool of page-aligned I/O buffers of a fixed size, shared by all of the
+ tasks of a session, so that transfers don't allocate a new buffer each time they start.
+ */
+@interface TOSMBBufferPool : NSObject
+
+/** The size of each buffer, in bytes. */
+@property (nonatomic, readonly) size_t bufferSize;
+
+/** The maximum number of idle buffers kept for reuse. Buffers returned beyond this are freed. */
+@property (nonatomic, readonly) NSUInteger maximumIdleBufferCount;
+
+/** The number of buffers that have been allocated since the pool was created. */
+@property (nonatomic, readonly) NSUInteger allocationCount;
+
+/** The number of times a buffer was handed out without allocating a new one. */
+@property (nonatomic, readonly) NSUInteger reuseCount;
+
+/** The number of buffers currently borrowed and not yet returned. */
+@property (nonatomic, readonly) NSUInteger outstandingBufferCount;
+
+- (instancetype)initWithBufferSize:(size_t)bufferSize maximumIdleBufferCount:(NSUInteger)maximumIdleBufferCount;
+
+/** Borrows a buffer from the pool, allocating a new one if none are idle. Returns NULL if allocation fails. */
+- (nullable void *)dequeueBuffer NS_RETURNS_INNER_POINTER;
+
+/** Returns a buffer obtained from `dequeueBuffer` to the pool. */
+- (void)enqueueBuffer:(nullable void *)buffer;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBBufferPool_h */
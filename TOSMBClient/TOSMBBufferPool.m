@@ -0,0 +1,136 @@
+//
+// TOSMBBufferPool.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <pthread.h>
+#import <stdlib.h>
+#import <unistd.h>
+
+#import "TOSMBBufferPool.h"
+
+@interface TOSMBBufferPool ()
+
+@property (nonatomic, assign, readwrite) size_t bufferSize;
+@property (nonatomic, assign, readwrite) NSUInteger maximumIdleBufferCount;
+
+@end
+
+@implementation TOSMBBufferPool
+{
+    pthread_mutex_t _lock;
+    void **_idleBuffers;            /* A stack of buffers ready to be reused */
+    NSUInteger _idleBufferCount;
+    NSUInteger _allocationCount;
+    NSUInteger _reuseCount;
+    NSUInteger _outstandingBufferCount;
+}
+
+- (instancetype)initWithBufferSize:(size_t)bufferSize maximumIdleBufferCount:(NSUInteger)maximumIdleBufferCount
+{
+    if (self = [super init]) {
+        _bufferSize = bufferSize;
+        _maximumIdleBufferCount = MAX(1, maximumIdleBufferCount);
+        _idleBuffers = calloc(_maximumIdleBufferCount, sizeof(void *));
+        pthread_mutex_init(&_lock, NULL);
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < _idleBufferCount; i++)
+        free(_idleBuffers[i]);
+    
+    free(_idleBuffers);
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Buffers -
+- (void *)dequeueBuffer
+{
+    void *buffer = NULL;
+    
+    pthread_mutex_lock(&_lock);
+    if (_idleBufferCount > 0) {
+        buffer = _idleBuffers[--_idleBufferCount];
+        _reuseCount++;
+        _outstandingBufferCount++;
+    }
+    pthread_mutex_unlock(&_lock);
+    
+    if (buffer)
+        return buffer;
+    
+    //Page aligned buffers let the kernel move the data without any extra copying
+    if (posix_memalign(&buffer, (size_t)getpagesize(), self.bufferSize) != 0)
+        return NULL;
+    
+    pthread_mutex_lock(&_lock);
+    _allocationCount++;
+    _outstandingBufferCount++;
+    pthread_mutex_unlock(&_lock);
+    
+    return buffer;
+}
+
+- (void)enqueueBuffer:(void *)buffer
+{
+    if (buffer == NULL)
+        return;
+    
+    pthread_mutex_lock(&_lock);
+    _outstandingBufferCount--;
+    if (_idleBufferCount < _maximumIdleBufferCount) {
+        _idleBuffers[_idleBufferCount++] = buffer;
+        buffer = NULL;
+    }
+    pthread_mutex_unlock(&_lock);
+    
+    free(buffer);
+}
+
+#pragma mark - Accessors -
+- (NSUInteger)allocationCount
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _allocationCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)reuseCount
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _reuseCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)outstandingBufferCount
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _outstandingBufferCount;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+@end
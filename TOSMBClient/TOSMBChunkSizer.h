@@ -0,0 +1,66 @@
+//
+// TOSMBChunkSizer.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBChunkSizer_h
+#define TOSMBChunkSizer_h
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Picks the number of bytes to request in each `smb_fread` or `smb_fwrite` call, by measuring
+ the throughput and latency of recent calls and stepping the size up or down to whichever performs best.
+ A single instance is shared by all of a session's tasks, and is thread-safe.
+ */
+@interface TOSMBChunkSizer : NSObject
+
+/** The smallest size that will be chosen. */
+@property (nonatomic, readonly) size_t minimumChunkSize;
+
+/** The largest size the device has shown it will accept. Starts at the largest size the protocol allows, and is
+ lowered if the device returns less than what was requested. */
+@property (nonatomic, readonly) size_t maximumChunkSize;
+
+/** A fixed size to use instead of adapting. 0 enables adapting. */
+@property (assign) size_t preferredChunkSize;
+
+/** The size that should be requested in the next call. */
+@property (nonatomic, readonly) size_t chunkSize;
+
+- (instancetype)initWithMinimumChunkSize:(size_t)minimumChunkSize maximumChunkSize:(size_t)maximumChunkSize;
+
+/**
+ Records the outcome of a single read or write call.
+ 
+ @param bytes The number of bytes that were actually transferred
+ @param requestedBytes The number of bytes that were requested
+ @param duration How long the call took
+ @param endOfFile Whether the call reached the end of the file (in which case a short transfer is expected)
+ */
+- (void)recordTransferOfBytes:(size_t)bytes requestedBytes:(size_t)requestedBytes duration:(NSTimeInterval)duration endOfFile:(BOOL)endOfFile;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBChunkSizer_h */
@@ -0,0 +1,146 @@
+//
+// TOSMBChunkSizer.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <pthread.h>
+
+#import "TOSMBChunkSizer.h"
+
+// How long to measure a chunk size for before comparing it against the last one
+static const NSTimeInterval TOSMBChunkSizerSampleDuration = 0.25;
+static const NSUInteger TOSMBChunkSizerMaximumSampleCount = 64;
+
+// A change in throughput smaller than this is treated as noise
+static const double TOSMBChunkSizerThroughputTolerance = 0.05;
+
+// Calls taking longer than this make progress updates and cancellation sluggish, so the size is lowered
+static const NSTimeInterval TOSMBChunkSizerMaximumLatency = 0.5;
+
+@interface TOSMBChunkSizer ()
+
+@property (nonatomic, assign, readwrite) size_t minimumChunkSize;
+@property (nonatomic, assign, readwrite) size_t maximumChunkSize;
+
+@end
+
+@implementation TOSMBChunkSizer
+{
+    pthread_mutex_t _lock;
+    size_t _adaptiveChunkSize;
+    BOOL _growing;                      /* Which direction the size was last stepped in */
+    
+    size_t _sampleBytes;                /* Measurements of the current size */
+    NSTimeInterval _sampleDuration;
+    NSUInteger _sampleCount;
+    
+    double _lastThroughput;             /* Bytes per second of the previous size */
+}
+
+- (instancetype)initWithMinimumChunkSize:(size_t)minimumChunkSize maximumChunkSize:(size_t)maximumChunkSize
+{
+    if (self = [super init]) {
+        _minimumChunkSize = MIN(minimumChunkSize, maximumChunkSize);
+        _maximumChunkSize = maximumChunkSize;
+        
+        //Start at the largest size, which suits most networks, and only step down if that measures slower
+        _adaptiveChunkSize = maximumChunkSize;
+        _growing = YES;
+        pthread_mutex_init(&_lock, NULL);
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Measurement -
+- (void)recordTransferOfBytes:(size_t)bytes requestedBytes:(size_t)requestedBytes duration:(NSTimeInterval)duration endOfFile:(BOOL)endOfFile
+{
+    if (self.preferredChunkSize > 0)
+        return;
+    
+    pthread_mutex_lock(&_lock);
+    
+    //A short transfer that isn't at the end of the file means the device won't accept requests this large
+    if (endOfFile == NO && bytes > 0 && bytes < requestedBytes && requestedBytes <= _maximumChunkSize) {
+        _maximumChunkSize = MAX(bytes, _minimumChunkSize);
+        _adaptiveChunkSize = MIN(_adaptiveChunkSize, _maximumChunkSize);
+    }
+    
+    _sampleBytes += bytes;
+    _sampleDuration += duration;
+    _sampleCount++;
+    
+    if (_sampleDuration >= TOSMBChunkSizerSampleDuration || _sampleCount >= TOSMBChunkSizerMaximumSampleCount) {
+        double throughput = _sampleDuration > 0 ? (_sampleBytes / _sampleDuration) : 0;
+        NSTimeInterval latency = _sampleDuration / _sampleCount;
+        
+        //Decide which way to step: keep going while it helps, turn around when it hurts, and hold when it makes no difference
+        BOOL shouldStep = YES;
+        if (latency > TOSMBChunkSizerMaximumLatency) {
+            _growing = NO;
+        }
+        else if (_lastThroughput > 0 && throughput < _lastThroughput * (1.0 - TOSMBChunkSizerThroughputTolerance)) {
+            _growing = !_growing;
+        }
+        else if (_lastThroughput > 0 && throughput < _lastThroughput * (1.0 + TOSMBChunkSizerThroughputTolerance)) {
+            shouldStep = NO;
+        }
+        
+        if (shouldStep) {
+            size_t chunkSize = _growing ? _adaptiveChunkSize * 2 : _adaptiveChunkSize / 2;
+            _adaptiveChunkSize = MIN(MAX(chunkSize, _minimumChunkSize), _maximumChunkSize);
+        }
+        
+        _lastThroughput = throughput;
+        _sampleBytes = 0;
+        _sampleDuration = 0;
+        _sampleCount = 0;
+    }
+    
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Accessors -
+- (size_t)chunkSize
+{
+    size_t preferredChunkSize = self.preferredChunkSize;
+    if (preferredChunkSize > 0)
+        return MIN(preferredChunkSize, self.maximumChunkSize);
+    
+    pthread_mutex_lock(&_lock);
+    size_t chunkSize = _adaptiveChunkSize;
+    pthread_mutex_unlock(&_lock);
+    return chunkSize;
+}
+
+- (size_t)maximumChunkSize
+{
+    pthread_mutex_lock(&_lock);
+    size_t maximumChunkSize = _maximumChunkSize;
+    pthread_mutex_unlock(&_lock);
+    return maximumChunkSize;
+}
+
+@end
@@ -30,9 +30,17 @@ FOUNDATION_EXPORT const unsigned char TOSMBClientVersionString[];
 
 #import "TOSMBSession.h"
 #import "TOSMBSessionFile.h"
+#import "TOSMBSessionDirectoryListing.h"
+#import "TOSMBSessionFileFilter.h"
+#import "TOSMBSessionTreeWalker.h"
+#import "TOSMBSessionFileReader.h"
 #import "TOSMBSessionTask.h"
 #import "TOSMBSessionDownloadTask.h"
+#import "TOSMBSessionBatchTask.h"
+#import "TOSMBSessionBatchDownloadTask.h"
+#import "TOSMBSessionDirectoryDownloadTask.h"
 #import "TOSMBSessionUploadTask.h"
+#import "TOSMBSessionDirectoryUploadTask.h"
 
 #import "TONetBIOSNameService.h"
 #import "TONetBIOSNameServiceEntry.h"
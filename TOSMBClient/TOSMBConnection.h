@@ -0,0 +1,96 @@
+//
+// TOSMBConnection.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBConnection_h
+#define TOSMBConnection_h
+
+#import <Foundation/Foundation.h>
+#import "smb_session.h"
+#import "smb_share.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A single libdsm session handle, along with the bookkeeping needed
+ to hand it out from, and return it to, a `TOSMBSession` connection pool.
+ The underlying `smb_session` is destroyed when this object is deallocated.
+ */
+@interface TOSMBConnection : NSObject
+
+/** The libdsm session pointer owned by this connection. */
+@property (nonatomic, readonly) smb_session *session;
+
+/** The time it took to connect and log in when this connection was first established. */
+@property (nonatomic, assign) NSTimeInterval handshakeDuration;
+
+/** The date this connection was last returned to the pool. */
+@property (nonatomic, strong, nullable) NSDate *lastUsedDate;
+
+/** Set when an operation on this connection failed, so it will be discarded instead of reused. */
+@property (nonatomic, assign, getter=isInvalid) BOOL invalid;
+
+/** Whether this connection is still logged in and hasn't been marked as invalid. */
+@property (nonatomic, readonly, getter=isAlive) BOOL alive;
+
+- (nullable instancetype)init;
+
+/**
+ Returns the tree ID for the named share, connecting to the share only
+ if this connection hasn't already done so.
+ 
+ @param shareName The name of the share to connect to
+ @param treeID A pointer that will be set to the tree ID of the share
+ @return An error if the share could not be connected to, or nil on success
+ */
+- (nullable NSError *)connectToShareWithName:(NSString *)shareName treeID:(smb_tid *)treeID;
+
+/**
+ Checks the last NT status of this connection, and if the server reported that
+ the tree ID is no longer valid, removes the cached tree ID for the named share.
+ 
+ @param shareName The name of the share whose request just failed
+ @return YES if the cached tree ID was stale and was removed, so the request may be retried
+ */
+- (BOOL)invalidateStaleTreeIDForShareName:(NSString *)shareName;
+
+/**
+ Performs a request against the named share, connecting to it first if needed. If the request fails
+ because the server no longer recognises the cached tree ID, the share is reconnected and the request
+ is performed once more.
+ 
+ @param shareName The name of the share to perform the request against
+ @param treeID An optional pointer that will be set to the tree ID the request was last performed with
+ @param block The request, which returns YES if it succeeded
+ @return An error if the share could not be connected to, or nil otherwise (Even if the request itself failed)
+ */
+- (nullable NSError *)performOnShareWithName:(NSString *)shareName
+                                      treeID:(nullable smb_tid *)treeID
+                                  usingBlock:(BOOL (^)(smb_tid treeID))block;
+
+/** Removes all cached tree IDs. Called whenever the underlying session is reconnected. */
+- (void)removeAllTreeIDs;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBConnection_h */
@@ -0,0 +1,128 @@
+//
+// TOSMBConnection.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBConnection.h"
+#import "TOSMBConstants.h"
+#import "smb_defs.h"
+
+@interface TOSMBConnection ()
+
+@property (nonatomic, assign, readwrite) smb_session *session;
+
+/* Tree IDs of the shares this connection has already connected to, keyed by share name */
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *treeIDs;
+
+@end
+
+@implementation TOSMBConnection
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _session = smb_session_new();
+        if (_session == NULL) {
+            return nil;
+        }
+        
+        _treeIDs = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_session) {
+        smb_session_destroy(_session);
+    }
+}
+
+#pragma mark - Share Trees -
+- (NSError *)connectToShareWithName:(NSString *)shareName treeID:(smb_tid *)treeID
+{
+    NSString *key = shareName.lowercaseString;
+    
+    NSNumber *cachedTreeID = self.treeIDs[key];
+    if (cachedTreeID) {
+        if (treeID)
+            *treeID = (smb_tid)cachedTreeID.unsignedShortValue;
+        return nil;
+    }
+    
+    const char *shareCString = [shareName cStringUsingEncoding:NSUTF8StringEncoding];
+    smb_tid newTreeID = 0;
+    if (shareCString == NULL || smb_tree_connect(self.session, shareCString, &newTreeID) != 0) {
+        return errorForErrorCode(TOSMBSessionErrorCodeShareConnectionFailed);
+    }
+    
+    self.treeIDs[key] = @(newTreeID);
+    
+    if (treeID)
+        *treeID = newTreeID;
+    
+    return nil;
+}
+
+- (BOOL)invalidateStaleTreeIDForShareName:(NSString *)shareName
+{
+    if (smb_session_get_nt_status(self.session) != NT_STATUS_SMB_BAD_TID)
+        return NO;
+    
+    [self.treeIDs removeObjectForKey:shareName.lowercaseString];
+    return YES;
+}
+
+- (NSError *)performOnShareWithName:(NSString *)shareName treeID:(smb_tid *)treeID usingBlock:(BOOL (^)(smb_tid))block
+{
+    smb_tid shareTreeID = 0;
+    NSError *error = [self connectToShareWithName:shareName treeID:&shareTreeID];
+    if (error)
+        return error;
+    
+    //If the cached tree ID has gone stale on the server, reconnect to the share and try once more
+    if (block(shareTreeID) == NO && [self invalidateStaleTreeIDForShareName:shareName]) {
+        error = [self connectToShareWithName:shareName treeID:&shareTreeID];
+        if (error == nil)
+            block(shareTreeID);
+    }
+    
+    if (treeID)
+        *treeID = shareTreeID;
+    
+    return error;
+}
+
+- (void)removeAllTreeIDs
+{
+    [self.treeIDs removeAllObjects];
+}
+
+#pragma mark - Accessors -
+- (BOOL)isAlive
+{
+    if (self.invalid || self.session == NULL)
+        return NO;
+    
+    return (smb_session_is_guest(self.session) >= 0);
+}
+
+@end
@@ -27,6 +27,11 @@
 
 extern NSString * const TOSMBClientErrorDomain;
 
+/** Posted on the session's `delegateQueue` (The main queue by default) when a directory listing served from the cache has been refreshed in the background.
+ * The notification object is the `TOSMBSession`, and the refreshed path is stored under `TOSMBSessionDirectoryPathKey`. */
+extern NSString * const TOSMBSessionDidRefreshDirectoryContentsNotification;
+extern NSString * const TOSMBSessionDirectoryPathKey;
+
 /** SMB Error Values */
 typedef NS_ENUM(NSInteger, TOSMBSessionErrorCode)
 {
@@ -39,6 +44,9 @@ typedef NS_ENUM(NSInteger, TOSMBSessionErrorCode)
     TOSMBSessionErrorCodeFileNotFound = 1005,            /* Unable to locate the requested file. */
     TOSMBSessionErrorCodeDirectoryDownloaded = 1006,     /* A directory was attempted to be downloaded. */
     TOSMBSessionErrorCodeFileDownloadFailed = 1007,      /* The file could not be downloaded, possible network error. */
+    TOSMBSessionErrorCodeFileTooLarge = 1008,            /* The file is too large to be read into memory. */
+    TOSMBSessionErrorCodeDirectoryCreationFailed = 1009, /* A directory could not be created on the device. */
+    TOSMBSessionErrorCodeFileUploadFailed = 1010,        /* The file could not be uploaded, possible network error. */
 
 };
 
@@ -60,6 +68,13 @@ typedef NS_ENUM(NSInteger, TOSMBSessionDownloadTaskState) {
     TOSMBSessionDownloadTaskStateFailed
 } __deprecated_enum_msg("Use TOSMBSessionTaskState values instead");
 
+/** How often a download task flushes the data it has written to disk */
+typedef NS_ENUM(NSInteger, TOSMBSessionDownloadDurability) {
+    TOSMBSessionDownloadDurabilityEveryChunk,       /* Flush after every chunk read from the network. */
+    TOSMBSessionDownloadDurabilityPeriodic,         /* Flush once enough bytes have been written, or enough time has passed. */
+    TOSMBSessionDownloadDurabilityOnCompletion      /* Only flush when the download finishes or is suspended. */
+};
+
 /** SMB Connection State */
 typedef NS_ENUM(NSUInteger, TOSMBSessionTaskState) {
     TOSMBSessionTaskStateReady,
@@ -26,6 +26,9 @@
 
 NSString * const TOSMBClientErrorDomain = @"TOSMBClient";
 
+NSString * const TOSMBSessionDidRefreshDirectoryContentsNotification = @"TOSMBSessionDidRefreshDirectoryContentsNotification";
+NSString * const TOSMBSessionDirectoryPathKey = @"TOSMBSessionDirectoryPathKey";
+
 TONetBIOSNameServiceType TONetBIOSNameServiceTypeForCType(char type)
 {
     switch (type) {
@@ -77,6 +80,15 @@ NSString *localizedStringForErrorCode(TOSMBSessionErrorCode errorCode)
         case TOSMBSessionErrorCodeFileDownloadFailed:
             errorMessage = @"File download failed - check your connection.";
             break;
+        case TOSMBSessionErrorCodeFileTooLarge:
+            errorMessage = @"File is too large to be read into memory.";
+            break;
+        case TOSMBSessionErrorCodeDirectoryCreationFailed:
+            errorMessage = @"Unable to create directory.";
+            break;
+        case TOSMBSessionErrorCodeFileUploadFailed:
+            errorMessage = @"File upload failed - check your connection.";
+            break;
         case TOSMBSessionErrorCodeUnknown:
         default:
             errorMessage = @"Unknown Error Occurred.";
@@ -0,0 +1,87 @@
+//
+// TOSMBDirectoryCache.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBDirectoryCache_h
+#define TOSMBDirectoryCache_h
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A thread-safe, in-memory store of directory listings, keyed by the
+ normalized path of the directory on the SMB device.
+ */
+@interface TOSMBDirectoryCache : NSObject
+
+/** The number of seconds a listing is considered fresh. */
+@property (nonatomic, assign) NSTimeInterval timeToLive;
+
+/** The number of lookups that were served from the cache. */
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+/** The number of lookups that had to go to the network. */
+@property (nonatomic, readonly) NSUInteger missCount;
+
+/**
+ Converts a file path into the key used to store its listing, by unifying slashes,
+ removing any trailing slash and ignoring case (As SMB paths are case-insensitive).
+ */
++ (NSString *)keyForPath:(nullable NSString *)path;
+
+/**
+ Looks up the cached listing for a directory, and records the lookup as a hit or a miss.
+ 
+ @param path The path of the directory
+ @param allowExpired Whether a listing older than `timeToLive` may still be returned
+ @param expired Set to YES if the returned listing is older than `timeToLive`
+ @return The cached files, or nil if there is no usable listing
+ */
+- (nullable NSArray *)filesForPath:(NSString *)path allowingExpired:(BOOL)allowExpired expired:(nullable BOOL *)expired;
+
+/** Stores a freshly downloaded listing for the directory at the given path. */
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path;
+
+/** Stores a listing that was retrieved at an earlier date, such as one loaded from the on-disk index. */
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path date:(NSDate *)date;
+
+/** Removes the listing of a single directory. */
+- (void)removeFilesForPath:(NSString *)path;
+
+/** Removes all listings. */
+- (void)removeAllFiles;
+
+/**
+ Marks a directory as being refreshed in the background.
+ 
+ @return NO if a refresh of this directory is already in progress.
+ */
+- (BOOL)beginRefreshForPath:(NSString *)path;
+
+/** Marks a background refresh of a directory as complete. */
+- (void)endRefreshForPath:(NSString *)path;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBDirectoryCache_h */
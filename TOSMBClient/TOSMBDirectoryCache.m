@@ -0,0 +1,155 @@
+//
+// TOSMBDirectoryCache.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBDirectoryCache.h"
+
+// -------------------------------------------------------------------------
+
+@interface TOSMBDirectoryCacheEntry : NSObject
+
+@property (nonatomic, copy) NSArray *files;
+@property (nonatomic, strong) NSDate *date;
+
+@end
+
+@implementation TOSMBDirectoryCacheEntry
+@end
+
+// -------------------------------------------------------------------------
+
+@interface TOSMBDirectoryCache ()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, TOSMBDirectoryCacheEntry *> *entries;
+@property (nonatomic, strong) NSMutableSet<NSString *> *refreshingKeys;
+
+@property (nonatomic, assign, readwrite) NSUInteger hitCount;
+@property (nonatomic, assign, readwrite) NSUInteger missCount;
+
+@end
+
+@implementation TOSMBDirectoryCache
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _entries = [NSMutableDictionary dictionary];
+        _refreshingKeys = [NSMutableSet set];
+    }
+    
+    return self;
+}
+
++ (NSString *)keyForPath:(NSString *)path
+{
+    if (path.length == 0)
+        return @"/";
+    
+    NSString *key = [path stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+    
+    //Collapse any repeated slashes (eg '//Share//Folder')
+    while ([key rangeOfString:@"//"].location != NSNotFound)
+        key = [key stringByReplacingOccurrencesOfString:@"//" withString:@"/"];
+    
+    if ([key hasPrefix:@"/"] == NO)
+        key = [@"/" stringByAppendingString:key];
+    
+    if (key.length > 1 && [key hasSuffix:@"/"])
+        key = [key substringToIndex:key.length - 1];
+    
+    return key.lowercaseString;
+}
+
+#pragma mark - Listings -
+- (NSArray *)filesForPath:(NSString *)path allowingExpired:(BOOL)allowExpired expired:(BOOL *)expired
+{
+    NSString *key = [TOSMBDirectoryCache keyForPath:path];
+    
+    @synchronized (self) {
+        TOSMBDirectoryCacheEntry *entry = self.entries[key];
+        BOOL isExpired = (entry && [[NSDate date] timeIntervalSinceDate:entry.date] > self.timeToLive);
+        
+        if (entry == nil || (isExpired && allowExpired == NO)) {
+            self.missCount++;
+            return nil;
+        }
+        
+        self.hitCount++;
+        
+        if (expired)
+            *expired = isExpired;
+        
+        return entry.files;
+    }
+}
+
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path
+{
+    [self setFiles:files forPath:path date:[NSDate date]];
+}
+
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path date:(NSDate *)date
+{
+    TOSMBDirectoryCacheEntry *entry = [[TOSMBDirectoryCacheEntry alloc] init];
+    entry.files = files;
+    entry.date = date;
+    
+    @synchronized (self) {
+        self.entries[[TOSMBDirectoryCache keyForPath:path]] = entry;
+    }
+}
+
+- (void)removeFilesForPath:(NSString *)path
+{
+    @synchronized (self) {
+        [self.entries removeObjectForKey:[TOSMBDirectoryCache keyForPath:path]];
+    }
+}
+
+- (void)removeAllFiles
+{
+    @synchronized (self) {
+        [self.entries removeAllObjects];
+    }
+}
+
+#pragma mark - Background Refreshing -
+- (BOOL)beginRefreshForPath:(NSString *)path
+{
+    NSString *key = [TOSMBDirectoryCache keyForPath:path];
+    
+    @synchronized (self) {
+        if ([self.refreshingKeys containsObject:key])
+            return NO;
+        
+        [self.refreshingKeys addObject:key];
+        return YES;
+    }
+}
+
+- (void)endRefreshForPath:(NSString *)path
+{
+    @synchronized (self) {
+        [self.refreshingKeys removeObject:[TOSMBDirectoryCache keyForPath:path]];
+    }
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+// TOSMBDirectoryIndex.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBDirectoryIndex_h
+#define TOSMBDirectoryIndex_h
+
+#import <Foundation/Foundation.h>
+
+@class TOSMBSession;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A persistent, SQLite-backed store of previously seen directory listings, keyed by host and
+ normalized directory path, so listings can be shown straight away the next time the app launches.
+ */
+@interface TOSMBDirectoryIndex : NSObject
+
+/** The file path of the index database on disk. */
+@property (nonatomic, readonly) NSString *path;
+
+/** The current size of the index database, in bytes. */
+@property (nonatomic, readonly) uint64_t size;
+
+/** The total time spent opening the index and reading listings out of it. */
+@property (nonatomic, readonly) NSTimeInterval loadTime;
+
+/**
+ Opens (or creates) the index database at the given path.
+ 
+ @return The index, or nil if the database could not be opened.
+ */
+- (nullable instancetype)initWithPath:(NSString *)path;
+
+/**
+ Reads the last stored listing of a directory.
+ 
+ @param path The path of the directory
+ @param host The host name or IP address of the device
+ @param session The session the created file objects will belong to
+ @return The stored files, sorted by name, or nil if this directory has never been stored.
+ */
+- (nullable NSArray *)filesForPath:(NSString *)path host:(NSString *)host session:(TOSMBSession *)session;
+
+/** Replaces the stored listing of a directory. */
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path host:(NSString *)host;
+
+/** Removes the stored listing of a single directory. */
+- (void)removeFilesForPath:(NSString *)path host:(NSString *)host;
+
+/** Removes all stored listings for a device. */
+- (void)removeAllFilesForHost:(NSString *)host;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBDirectoryIndex_h */
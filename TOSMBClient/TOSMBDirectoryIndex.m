@@ -0,0 +1,256 @@
+//
+// TOSMBDirectoryIndex.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <sqlite3.h>
+
+#import "TOSMBDirectoryIndex.h"
+#import "TOSMBDirectoryCache.h"
+#import "TOSMBSessionFile.h"
+#import "TOSMBSessionFilePrivate.h"
+
+@interface TOSMBDirectoryIndex ()
+
+@property (nonatomic, copy, readwrite) NSString *path;
+@property (nonatomic, assign, readwrite) NSTimeInterval loadTime;
+
+- (BOOL)executeStatement:(const char *)sql host:(NSString *)host key:(nullable NSString *)key;
+
+@end
+
+@implementation TOSMBDirectoryIndex
+{
+    sqlite3 *_database;
+}
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    if (self = [super init]) {
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        
+        _path = [path copy];
+        
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
+        if (sqlite3_open_v2(path.fileSystemRepresentation, &_database, flags, NULL) != SQLITE_OK) {
+            sqlite3_close(_database);
+            _database = NULL;
+            return nil;
+        }
+        
+        //Every directory that's been listed gets a row in 'directories' (So empty directories are remembered too),
+        //and each of its entries gets a row in 'entries' holding the raw SMB_STAT_* values
+        const char *schema =
+            "PRAGMA journal_mode = WAL;"
+            "CREATE TABLE IF NOT EXISTS directories ("
+                "host TEXT NOT NULL, path TEXT NOT NULL, updated REAL NOT NULL, "
+                "PRIMARY KEY (host, path));"
+            "CREATE TABLE IF NOT EXISTS entries ("
+                "host TEXT NOT NULL, path TEXT NOT NULL, name TEXT NOT NULL, "
+                "size INTEGER, allocation_size INTEGER, directory INTEGER, "
+                "ctime INTEGER, atime INTEGER, wtime INTEGER, mtime INTEGER, "
+                "PRIMARY KEY (host, path, name));";
+        
+        if (sqlite3_exec(_database, schema, NULL, NULL, NULL) != SQLITE_OK) {
+            sqlite3_close(_database);
+            _database = NULL;
+            return nil;
+        }
+        
+        _loadTime = CFAbsoluteTimeGetCurrent() - startTime;
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_database)
+        sqlite3_close(_database);
+}
+
+#pragma mark - Listings -
+- (NSArray *)filesForPath:(NSString *)path host:(NSString *)host session:(TOSMBSession *)session
+{
+    NSString *key = [TOSMBDirectoryCache keyForPath:path];
+    BOOL isRoot = [key isEqualToString:@"/"];
+    NSMutableArray *files = nil;
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    
+    @synchronized (self) {
+        sqlite3_stmt *statement = NULL;
+        
+        //Make sure we've actually stored this directory before, even if it was empty. Any statement that can't be
+        //prepared (eg, a corrupted database) is treated as the directory not being stored.
+        BOOL found = NO;
+        if (sqlite3_prepare_v2(_database, "SELECT 1 FROM directories WHERE host = ?1 AND path = ?2;", -1, &statement, NULL) == SQLITE_OK) {
+            sqlite3_bind_text(statement, 1, host.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(statement, 2, key.UTF8String, -1, SQLITE_TRANSIENT);
+            found = (sqlite3_step(statement) == SQLITE_ROW);
+            sqlite3_finalize(statement);
+        }
+        
+        if (found && sqlite3_prepare_v2(_database, "SELECT name, size, allocation_size, directory, ctime, atime, wtime, mtime "
+                                                   "FROM entries WHERE host = ?1 AND path = ?2;", -1, &statement, NULL) == SQLITE_OK) {
+            files = [NSMutableArray array];
+            
+            sqlite3_bind_text(statement, 1, host.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(statement, 2, key.UTF8String, -1, SQLITE_TRANSIENT);
+            
+            while (sqlite3_step(statement) == SQLITE_ROW) {
+                const char *name = (const char *)sqlite3_column_text(statement, 0);
+                if (name == NULL)
+                    continue;
+                
+                NSString *nameString = [NSString stringWithUTF8String:name];
+                
+                //The root of the device lists the shares
+                if (isRoot) {
+                    [files addObject:[[TOSMBSessionFile alloc] initWithShareName:nameString session:session]];
+                    continue;
+                }
+                
+                TOSMBSessionFile *file = [[TOSMBSessionFile alloc] initWithName:nameString
+                                                                       fileSize:(uint64_t)sqlite3_column_int64(statement, 1)
+                                                                 allocationSize:(uint64_t)sqlite3_column_int64(statement, 2)
+                                                                      directory:(sqlite3_column_int(statement, 3) != 0)
+                                                              creationTimestamp:(uint64_t)sqlite3_column_int64(statement, 4)
+                                                                accessTimestamp:(uint64_t)sqlite3_column_int64(statement, 5)
+                                                                 writeTimestamp:(uint64_t)sqlite3_column_int64(statement, 6)
+                                                          modificationTimestamp:(uint64_t)sqlite3_column_int64(statement, 7)
+                                                                        session:session
+                                                        parentDirectoryFilePath:path];
+                [files addObject:file];
+            }
+            sqlite3_finalize(statement);
+        }
+        
+        self.loadTime += CFAbsoluteTimeGetCurrent() - startTime;
+    }
+    
+    if (files == nil)
+        return nil;
+    
+    //Match the order of listings coming from the device
+    return [files sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"name" ascending:YES]]];
+}
+
+- (void)setFiles:(NSArray *)files forPath:(NSString *)path host:(NSString *)host
+{
+    NSString *key = [TOSMBDirectoryCache keyForPath:path];
+    
+    @synchronized (self) {
+        //Replace the whole directory in a single transaction, so a crash can't leave half a listing behind
+        if (sqlite3_exec(_database, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+            return;
+        
+        BOOL success = [self executeStatement:"DELETE FROM entries WHERE host = ?1 AND path = ?2;" host:host key:key];
+        
+        sqlite3_stmt *statement = NULL;
+        if (success && sqlite3_prepare_v2(_database, "INSERT OR REPLACE INTO entries "
+                                                     "(host, path, name, size, allocation_size, directory, ctime, atime, wtime, mtime) "
+                                                     "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);", -1, &statement, NULL) != SQLITE_OK)
+            success = NO;
+        
+        for (TOSMBSessionFile *file in (success ? files : nil)) {
+            sqlite3_bind_text(statement, 1, host.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(statement, 2, key.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(statement, 3, file.name.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(statement, 4, (sqlite3_int64)file.fileSize);
+            sqlite3_bind_int64(statement, 5, (sqlite3_int64)file.allocationSize);
+            sqlite3_bind_int(statement, 6, file.directory ? 1 : 0);
+            sqlite3_bind_int64(statement, 7, (sqlite3_int64)file.creationTimestamp);
+            sqlite3_bind_int64(statement, 8, (sqlite3_int64)file.accessTimestamp);
+            sqlite3_bind_int64(statement, 9, (sqlite3_int64)file.writeTimestamp);
+            sqlite3_bind_int64(statement, 10, (sqlite3_int64)file.modificationTimestamp);
+            if (sqlite3_step(statement) != SQLITE_DONE) {
+                success = NO;
+                break;
+            }
+            sqlite3_reset(statement);
+        }
+        sqlite3_finalize(statement);
+        statement = NULL;
+        
+        //The directory is only marked as stored once all of its entries are
+        if (success && sqlite3_prepare_v2(_database, "INSERT OR REPLACE INTO directories (host, path, updated) VALUES (?1, ?2, ?3);", -1, &statement, NULL) == SQLITE_OK) {
+            sqlite3_bind_text(statement, 1, host.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(statement, 2, key.UTF8String, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(statement, 3, [NSDate date].timeIntervalSince1970);
+            success = (sqlite3_step(statement) == SQLITE_DONE);
+            sqlite3_finalize(statement);
+        }
+        else {
+            success = NO;
+        }
+        
+        //Leave the previously stored listing as it was, rather than storing part of this one
+        sqlite3_exec(_database, success ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
+    }
+}
+
+- (void)removeFilesForPath:(NSString *)path host:(NSString *)host
+{
+    NSString *key = [TOSMBDirectoryCache keyForPath:path];
+    
+    @synchronized (self) {
+        [self executeStatement:"DELETE FROM entries WHERE host = ?1 AND path = ?2;" host:host key:key];
+        [self executeStatement:"DELETE FROM directories WHERE host = ?1 AND path = ?2;" host:host key:key];
+    }
+}
+
+- (void)removeAllFilesForHost:(NSString *)host
+{
+    @synchronized (self) {
+        [self executeStatement:"DELETE FROM entries WHERE host = ?1;" host:host key:nil];
+        [self executeStatement:"DELETE FROM directories WHERE host = ?1;" host:host key:nil];
+    }
+}
+
+- (BOOL)executeStatement:(const char *)sql host:(NSString *)host key:(NSString *)key
+{
+    sqlite3_stmt *statement = NULL;
+    if (sqlite3_prepare_v2(_database, sql, -1, &statement, NULL) != SQLITE_OK)
+        return NO;
+    
+    sqlite3_bind_text(statement, 1, host.UTF8String, -1, SQLITE_TRANSIENT);
+    if (key)
+        sqlite3_bind_text(statement, 2, key.UTF8String, -1, SQLITE_TRANSIENT);
+    
+    BOOL success = (sqlite3_step(statement) == SQLITE_DONE);
+    sqlite3_finalize(statement);
+    return success;
+}
+
+#pragma mark - Accessors -
+- (uint64_t)size
+{
+    //Include the write-ahead log, as recent changes may not have been checkpointed into the main file yet
+    uint64_t size = 0;
+    for (NSString *suffix in @[@"", @"-wal"]) {
+        NSString *filePath = [self.path stringByAppendingString:suffix];
+        size += [[[NSFileManager defaultManager] attributesOfItemAtPath:filePath error:nil] fileSize];
+    }
+    
+    return size;
+}
+
+@end
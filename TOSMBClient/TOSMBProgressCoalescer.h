@@ -0,0 +1,60 @@
+//
+// TOSMBProgressCoalescer.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBProgressCoalescer_h
+#define TOSMBProgressCoalescer_h
+
+#import <Foundation/Foundation.h>
+
+@class TOSMBSessionTask;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Collects progress updates from a session's tasks as they happen on worker threads, and delivers
+ them on a delegate queue no more often than a minimum interval. A task only ever has one pending update,
+ which always reflects its latest progress when it's delivered.
+ */
+@interface TOSMBProgressCoalescer : NSObject
+
+/** The minimum number of seconds between deliveries. */
+@property (assign) NSTimeInterval minimumInterval;
+
+/** The queue deliveries are made on. Default: the main queue. */
+@property (strong) NSOperationQueue *delegateQueue;
+
+/** Called once per delivery with every task whose progress was just delivered. */
+@property (copy, nullable) void (^batchHandler)(NSArray<TOSMBSessionTask *> *tasks);
+
+/**
+ Marks a task as having new progress to deliver.
+ 
+ @param task The task that made progress
+ @param final Whether the task has completed, in which case the update is delivered straight away
+ */
+- (void)addTask:(TOSMBSessionTask *)task final:(BOOL)final;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBProgressCoalescer_h */
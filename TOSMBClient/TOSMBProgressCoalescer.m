@@ -0,0 +1,99 @@
+//
+// TOSMBProgressCoalescer.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBProgressCoalescer.h"
+#import "TOSMBSessionTaskPrivate.h"
+
+@interface TOSMBProgressCoalescer ()
+
+@property (nonatomic, strong) NSMutableOrderedSet<TOSMBSessionTask *> *pendingTasks;
+@property (nonatomic, assign) BOOL deliveryScheduled;
+@property (nonatomic, assign) CFAbsoluteTime lastDeliveryTime;
+
+- (void)deliver;
+
+@end
+
+@implementation TOSMBProgressCoalescer
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _pendingTasks = [NSMutableOrderedSet orderedSet];
+        _delegateQueue = [NSOperationQueue mainQueue];
+    }
+    
+    return self;
+}
+
+- (void)addTask:(TOSMBSessionTask *)task final:(BOOL)final
+{
+    NSTimeInterval delay = 0;
+    
+    @synchronized (self) {
+        [self.pendingTasks addObject:task];
+        
+        //A delivery is already on its way, and will pick this task up (Unless this is the final update, which shouldn't wait)
+        if (self.deliveryScheduled && final == NO)
+            return;
+        
+        self.deliveryScheduled = YES;
+        
+        if (final == NO) {
+            NSTimeInterval timeSinceLastDelivery = CFAbsoluteTimeGetCurrent() - self.lastDeliveryTime;
+            delay = MAX(0, self.minimumInterval - timeSinceLastDelivery);
+        }
+    }
+    
+    NSOperationQueue *delegateQueue = self.delegateQueue;
+    if (delay <= 0) {
+        [delegateQueue addOperationWithBlock:^{ [self deliver]; }];
+        return;
+    }
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [delegateQueue addOperationWithBlock:^{ [self deliver]; }];
+    });
+}
+
+- (void)deliver
+{
+    NSArray<TOSMBSessionTask *> *tasks = nil;
+    
+    @synchronized (self) {
+        tasks = self.pendingTasks.array;
+        [self.pendingTasks removeAllObjects];
+        self.deliveryScheduled = NO;
+        self.lastDeliveryTime = CFAbsoluteTimeGetCurrent();
+    }
+    
+    if (tasks.count == 0)
+        return;
+    
+    for (TOSMBSessionTask *task in tasks)
+        [task deliverProgress];
+    
+    if (self.batchHandler)
+        self.batchHandler(tasks);
+}
+
+@end
@@ -23,10 +23,25 @@
 #import <Foundation/Foundation.h>
 #import "TOSMBConstants.h"
 
+@class TOSMBSessionTask;
 @class TOSMBSessionDownloadTask;
 @class TOSMBSessionUploadTask;
+@class TOSMBSessionBatchDownloadTask;
+@class TOSMBSessionDirectoryDownloadTask;
+@class TOSMBSessionDirectoryUploadTask;
+
+@class TOSMBSessionFile;
+@class TOSMBSessionDirectoryListing;
+@class TOSMBSessionTreeWalker;
+@class TOSMBSessionFileReader;
+@class TOSMBSessionFileFilter;
 
 @protocol TOSMBSessionDownloadTaskDelegate;
+@protocol TOSMBSessionBatchDownloadTaskDelegate;
+@protocol TOSMBSessionDirectoryUploadTaskDelegate;
+
+/** The number of files delivered per batch when enumerating a directory, if no batch size is given. */
+extern const NSUInteger TOSMBSessionDefaultEnumerationBatchSize;
 
 @interface TOSMBSession : NSObject
 
@@ -41,14 +56,96 @@
 
 @property (nonatomic, readonly) NSArray <TOSMBSessionDownloadTask *> *downloadTasks;
 @property (nonatomic, readonly) NSArray <TOSMBSessionUploadTask *> *uploadTasks;
+@property (nonatomic, readonly) NSArray <TOSMBSessionBatchDownloadTask *> *batchDownloadTasks;
+@property (nonatomic, readonly) NSArray <TOSMBSessionDirectoryUploadTask *> *directoryUploadTasks;
 
 @property (nonatomic, readonly) dispatch_queue_t serialQueue;
 @property (nonatomic, readonly) NSOperationQueue *taskQueue;
 
+/** The queue on which all task delegate methods, task handlers and directory listing callbacks are
+ * delivered. Callbacks are always enqueued asynchronously, so the worker threads performing the network
+ * requests never wait on them. Setting this to nil restores the default. Default: the main queue. */
+@property (nonatomic, strong, null_resettable) NSOperationQueue *delegateQueue;
+
 /** Defines the number of concurrent task operations. Default:
  * NSOperationQueueDefaultMaxConcurrentOperationCount. */
 @property (nonatomic) NSInteger maxTaskOperationCount;
 
+/** The maximum number of idle, logged-in connections kept around for reuse by
+ * download and upload tasks. Setting this to 0 disables connection pooling. Default: 4. */
+@property (nonatomic) NSInteger maxPooledConnectionCount;
+
+/** The number of seconds an idle pooled connection is kept before it is closed. Default: 60. */
+@property (nonatomic) NSTimeInterval pooledConnectionIdleTimeout;
+
+/** The number of times a task was handed an already logged-in connection from the pool. */
+@property (nonatomic, readonly) NSUInteger connectionPoolHitCount;
+
+/** The number of times a task had to connect and log in from scratch. */
+@property (nonatomic, readonly) NSUInteger connectionPoolMissCount;
+
+/** The accumulated connect and login time that was avoided by reusing pooled connections. */
+@property (nonatomic, readonly) NSTimeInterval connectionPoolHandshakeTimeSaved;
+
+/** The number of I/O buffers that tasks have had to allocate. Once transfers reach a steady state, this stops growing. */
+@property (nonatomic, readonly) NSUInteger bufferPoolAllocationCount;
+
+/** The number of times a task reused an I/O buffer returned by an earlier task, rather than allocating one. */
+@property (nonatomic, readonly) NSUInteger bufferPoolReuseCount;
+
+/** The minimum number of seconds between progress updates delivered for tasks. The final update
+ * of a task is always delivered straight away. Default: 0.1. */
+@property (nonatomic) NSTimeInterval progressUpdateInterval;
+
+/** The minimum number of bytes a task must transfer between progress updates. Default: 0. */
+@property (nonatomic) uint64_t progressUpdateByteDelta;
+
+/** Called on the delegate queue once per progress delivery, with every task whose progress handlers
+ * and delegates were just updated. Useful for updating the UI for many tasks at once. */
+@property (nonatomic, copy) void (^taskProgressHandler)(NSArray<TOSMBSessionTask *> *tasks);
+
+/** A fixed number of bytes for tasks to request in each read or write call. Setting this to 0 lets the session
+ * pick the size from the measured throughput and latency of recent calls. Default: 0. */
+@property (nonatomic) NSUInteger preferredChunkSize;
+
+/** The number of bytes presently requested in each read call made by download tasks. */
+@property (nonatomic, readonly) NSUInteger currentReadChunkSize;
+
+/** The number of bytes presently sent in each write call made by upload tasks. */
+@property (nonatomic, readonly) NSUInteger currentWriteChunkSize;
+
+/** The largest file, in bytes, whose contents may be read straight into memory. Default: 1 MB. */
+@property (nonatomic) uint64_t maximumInMemoryFileSize;
+
+/** The number of seconds directory listings are cached in memory before being requested
+ * from the device again. Setting this to 0 disables the cache. Default: 0. */
+@property (nonatomic) NSTimeInterval directoryCacheTimeout;
+
+/** When YES, an expired cached listing is returned immediately, and is refreshed in the background.
+ * `TOSMBSessionDidRefreshDirectoryContentsNotification` is posted once the refresh completes. Default: NO. */
+@property (nonatomic) BOOL returnsStaleDirectoryContents;
+
+/** The number of directory listings that were served from the cache. */
+@property (nonatomic, readonly) NSUInteger directoryCacheHitCount;
+
+/** The number of directory listings that had to be requested from the device. */
+@property (nonatomic, readonly) NSUInteger directoryCacheMissCount;
+
+/** The file path of a database used to remember directory listings between launches. When set, a listing that was
+ * seen before is returned straight away, even before connecting to the device, and is then reconciled with the device
+ * in the background (Posting `TOSMBSessionDidRefreshDirectoryContentsNotification` once done).
+ * Setting this to nil disables the index. Default: nil. */
+@property (nonatomic, copy) NSString *directoryIndexPath;
+
+/** The size of the directory index on disk, in bytes. */
+@property (nonatomic, readonly) uint64_t directoryIndexSize;
+
+/** The total time spent opening the directory index, and reading listings out of it. */
+@property (nonatomic, readonly) NSTimeInterval directoryIndexLoadTime;
+
+/** The total time spent reconciling listings from the directory index with the device, and writing them back. */
+@property (nonatomic, readonly) NSTimeInterval directoryIndexReconcileTime;
+
 /**
  Creates a new SMB object, but doesn't try to connect until the first request is made.
  For a successful connection, most devices require both the host name and the IP address.
@@ -109,11 +206,204 @@
  */
 - (void)requestContentsOfDirectoryAtFilePath:(NSString *)path success:(void (^)(NSArray *files))successHandler error:(void (^)(NSError *))errorHandler;
 
+/**
+ Performs a synchronous request for the files in a directory that match a filter. The filter's name pattern is
+ evaluated by the device, and its remaining conditions are checked as each entry is read.
+ Filtered listings are never cached. The filter isn't applied to the root list of share folders.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param filter The conditions that files must match. Supplying nil matches every file.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return An NSArray of TOSMBFile objects matching the filter, sorted by name
+ */
+- (NSArray *)requestContentsOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error;
+
+/**
+ Performs an asynchronous request for the files in a directory that match a filter.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param filter The conditions that files must match. Supplying nil matches every file.
+ @param successHandler A block called on the delegate queue with the matching files, sorted by name
+ @param errorHandler A block called on the delegate queue if an error occurs.
+ */
+- (void)requestContentsOfDirectoryAtFilePath:(NSString *)path
+                                      filter:(TOSMBSessionFileFilter *)filter
+                                     success:(void (^)(NSArray *files))successHandler
+                                       error:(void (^)(NSError *error))errorHandler;
+
+/**
+ Performs a synchronous request for a compact listing of the files in a directory. Rather than creating a
+ `TOSMBSessionFile` object for every entry up front, the listing stores the raw values of each entry and only
+ creates file objects when they're accessed. This is much cheaper for directories with a very large number of files.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return A listing of the directory, sorted by name
+ */
+- (TOSMBSessionDirectoryListing *)requestListingOfDirectoryAtFilePath:(NSString *)path error:(NSError **)error;
+
+/**
+ Performs a synchronous request for a compact listing of the files in a directory that match a filter.
+ Entries that don't match are never copied into the listing.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param filter The conditions that files must match. Supplying nil matches every file.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return A listing of the matching files, sorted by name
+ */
+- (TOSMBSessionDirectoryListing *)requestListingOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error;
+
+/**
+ Performs an asynchronous request for a compact listing of the files in a directory.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param successHandler A block called on the delegate queue with the listing, sorted by name
+ @param errorHandler A block called on the delegate queue if an error occurs.
+ */
+- (void)requestListingOfDirectoryAtFilePath:(NSString *)path
+                                    success:(void (^)(TOSMBSessionDirectoryListing *listing))successHandler
+                                      error:(void (^)(NSError *error))errorHandler;
+
+/**
+ Performs a synchronous request for the contents of a directory, delivering the files in batches as they're
+ read, instead of building, and sorting, an array of the whole directory. This keeps memory usage proportional to
+ the batch size, which is useful for directories containing tens of thousands of files.
+ Files are delivered in the order the device returned them, and shares are delivered for the root path.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param batchSize The maximum number of files delivered per batch. 0 uses `TOSMBSessionDefaultEnumerationBatchSize`.
+ @param block A block called for each batch of files. Set `stop` to YES to end the enumeration early.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return YES if the directory was enumerated (or stopped early) without error
+ */
+- (BOOL)enumerateContentsOfDirectoryAtFilePath:(NSString *)path
+                                     batchSize:(NSUInteger)batchSize
+                                    usingBlock:(void (^)(NSArray<TOSMBSessionFile *> *files, BOOL *stop))block
+                                         error:(NSError **)error;
+
+/**
+ Performs an asynchronous, batched enumeration of the contents of a directory.
+ Batches and the completion handler are delivered on the delegate queue.
+ 
+ @param path The file path to request. Supplying nil or "" will request the root list of share folders
+ @param batchSize The maximum number of files delivered per batch. 0 uses `TOSMBSessionDefaultEnumerationBatchSize`.
+ @param batchHandler A block called for each batch of files. Set `stop` to YES to end the enumeration early.
+ @param completionHandler A block called once the enumeration has finished, with an error if one occurred.
+ */
+- (void)enumerateContentsOfDirectoryAtFilePath:(NSString *)path
+                                     batchSize:(NSUInteger)batchSize
+                                  batchHandler:(void (^)(NSArray<TOSMBSessionFile *> *files, BOOL *stop))batchHandler
+                             completionHandler:(void (^)(NSError *error))completionHandler;
+
 /**
  Cancels any and all file contents requests both actively occurring, and pending.
  */
 - (void)cancelAllRequests;
 
+/**
+ Removes the cached listing of a directory, so the next request for it will go to the device.
+ This is done automatically for the parent directory of a file when an upload task completes.
+ 
+ @param path The file path of the directory
+ */
+- (void)invalidateCachedContentsOfDirectoryAtFilePath:(NSString *)path;
+
+/**
+ Removes all cached directory listings, including those of this device stored in the directory index.
+ */
+- (void)removeAllCachedDirectoryContents;
+
+/**
+ Closes all of the idle connections currently held in the connection pool.
+ Connections presently in use by tasks are unaffected.
+ */
+- (void)closeIdleConnections;
+
+/**
+ Creates a tree walker object for recursively listing everything beneath a directory, using several
+ pooled connections in parallel. Configure the walker's handlers, and then call `start` on it.
+
+ @param path The directory to walk. Supplying nil, "" or "/" will walk every share on the device.
+
+ @return A tree walker ready to be started.
+ */
+- (TOSMBSessionTreeWalker *)treeWalkerForDirectoryAtPath:(NSString *)path;
+
+/**
+ Creates a reader object for reading arbitrary ranges of a file without downloading all of it,
+ such as when seeking through a media file. The reader keeps the file open on a pooled connection
+ until it is closed.
+ 
+ @param path The file to read.
+ 
+ @return A file reader, which opens the file when it is first read from.
+ */
+- (TOSMBSessionFileReader *)fileReaderForFileAtPath:(NSString *)path;
+
+/**
+ Performs a synchronous request for the entire contents of a small file, read straight into memory without
+ touching the disk. Files larger than `maximumInMemoryFileSize` fail with `TOSMBSessionErrorCodeFileTooLarge`.
+ This will block the current thread, so must not be called on the main thread.
+ 
+ @param path The file path to request.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return The contents of the file, or nil if an error occurred.
+ */
+- (NSData *)requestContentsOfFileAtPath:(NSString *)path error:(NSError **)error;
+
+/**
+ As above, but reads the contents of the file into a buffer supplied by the caller.
+ Files larger than the buffer (Or `maximumInMemoryFileSize`) fail with `TOSMBSessionErrorCodeFileTooLarge`.
+ 
+ @param path The file path to request.
+ @param buffer The buffer to read the file into.
+ @param length The size of the buffer, in bytes.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return The number of bytes read into the buffer, or -1 if an error occurred.
+ */
+- (NSInteger)readContentsOfFileAtPath:(NSString *)path intoBuffer:(void *)buffer length:(NSUInteger)length error:(NSError **)error;
+
+/**
+ Performs a synchronous request for the contents of many small files, all read over a single connection.
+ 
+ @param paths The file paths to request.
+ @param errors A pointer to a dictionary that will contain the error for each file that couldn't be read, if any.
+ @return The contents of each file that was read, keyed by its path.
+ */
+- (NSDictionary<NSString *, NSData *> *)requestContentsOfFilesAtPaths:(NSArray<NSString *> *)paths
+                                                              errors:(NSDictionary<NSString *, NSError *> **)errors;
+
+/**
+ Performs an asynchronous request for the entire contents of a small file, read straight into memory.
+ 
+ @param path The file path to request.
+ @param successHandler A block called on the delegate queue with the contents of the file.
+ @param errorHandler A block called on the delegate queue if an error occurs.
+ */
+- (void)requestContentsOfFileAtPath:(NSString *)path
+                            success:(void (^)(NSData *data))successHandler
+                              error:(void (^)(NSError *error))errorHandler;
+
+/**
+ Performs an asynchronous request for the contents of many small files, all read over a single connection.
+ 
+ @param paths The file paths to request.
+ @param completionHandler A block called on the delegate queue with the contents of each file that was read,
+ and the error of each file that wasn't, both keyed by path.
+ */
+- (void)requestContentsOfFilesAtPaths:(NSArray<NSString *> *)paths
+                    completionHandler:(void (^)(NSDictionary<NSString *, NSData *> *contents, NSDictionary<NSString *, NSError *> *errors))completionHandler;
+
+/**
+ Performs a synchronous request to create a directory. The directory it goes in must already exist.
+ This will block the current thread, so must not be called on the main thread.
+ 
+ @param path The path of the new directory.
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return YES if the directory was created, or already existed.
+ */
+- (BOOL)createDirectoryAtPath:(NSString *)path error:(NSError **)error;
+
 /**
  Creates a download task object for asynchronously downloading a file to
  disk. Only files may be downloaded; folders will return an error.
@@ -147,6 +437,112 @@
                                         progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
                                       completionHandler:(void (^)(NSString *filePath))completionHandler
                                             failHandler:(void (^)(NSError *error))failHandler;
+/**
+ Creates a download task object that only downloads parts of a file, such as the start of a media file
+ for probing its format. The ranges are written at their original offsets in a file the same size as
+ the one on the device, with the parts in between left empty (As holes, where the file system supports them).
+ Progress is measured against the total length of the requested ranges.
+ 
+ @param ranges The byte ranges to download, as NSRange values.
+ @param path The path on the SMB device for the file to download.
+ @param destinationPath The destination path (Either just the directory, or even a new name) for this file.
+ @param progressHandler A block periodically called as the download progresses.
+ @param completionHandler A block called once the download has completed.
+ @param failHandler A block called if the download fails
+ 
+ @return A download task object ready to be started, or nil upon failure.
+ */
+- (TOSMBSessionDownloadTask *)downloadTaskForByteRanges:(NSArray<NSValue *> *)ranges
+                                           ofFileAtPath:(NSString *)path
+                                        destinationPath:(NSString *)destinationPath
+                                        progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                      completionHandler:(void (^)(NSString *filePath))completionHandler
+                                            failHandler:(void (^)(NSError *error))failHandler;
+
+/**
+ Creates a download task object that downloads parts of a file into memory, without touching the disk.
+ 
+ @param ranges The byte ranges to download, as NSRange values.
+ @param path The path on the SMB device for the file to download.
+ @param progressHandler A block periodically called as the download progresses.
+ @param completionHandler A block called once the download has completed, with the data of each range in the order they were supplied.
+ @param failHandler A block called if the download fails
+ 
+ @return A download task object ready to be started, or nil upon failure.
+ */
+- (TOSMBSessionDownloadTask *)downloadTaskForByteRanges:(NSArray<NSValue *> *)ranges
+                                           ofFileAtPath:(NSString *)path
+                                        progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                      completionHandler:(void (^)(NSArray<NSData *> *data))completionHandler
+                                            failHandler:(void (^)(NSError *error))failHandler;
+
+/**
+ Creates a batch download task object for downloading many files into a single directory. Rather than each
+ file getting its own task and connection, the files are downloaded back-to-back over a small pool of connections,
+ which is much faster for large numbers of small files.
+ 
+ Files keep their paths relative to the deepest folder they have in common, so files from different folders
+ that share a name don't overwrite each other.
+ 
+ @param paths The paths on the SMB device of the files to download.
+ @param destinationPath The local directory to download the files into.
+ @param delegate A delegate object that will call update methods during the download.
+ 
+ @return A batch download task object ready to be started.
+ */
+- (TOSMBSessionBatchDownloadTask *)batchDownloadTaskForFilesAtPaths:(NSArray<NSString *> *)paths
+                                                    destinationPath:(NSString *)destinationPath
+                                                           delegate:(id <TOSMBSessionBatchDownloadTaskDelegate>)delegate;
+
+/**
+ Same as above, creates a batch download task object for downloading many files into a single directory.
+ 
+ @param paths The paths on the SMB device of the files to download.
+ @param destinationPath The local directory to download the files into.
+ @param progressHandler A block periodically called with the progress of the whole batch.
+ @param completionHandler A block called once every file has been attempted. Check `fileErrors` for any that failed.
+ @param failHandler A block called if the batch couldn't be downloaded at all
+ 
+ @return A batch download task object ready to be started.
+ */
+- (TOSMBSessionBatchDownloadTask *)batchDownloadTaskForFilesAtPaths:(NSArray<NSString *> *)paths
+                                                    destinationPath:(NSString *)destinationPath
+                                                    progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                  completionHandler:(void (^)(void))completionHandler
+                                                        failHandler:(void (^)(NSError *error))failHandler;
+
+/**
+ Creates a task object for downloading a directory and everything inside it. The directory is recreated inside
+ the destination directory, with the same hierarchy of folders. Files are downloaded over several connections
+ at once while the rest of the tree is still being listed, with the smallest files found so far going first.
+ 
+ @param path The path on the SMB device of the directory to download.
+ @param destinationPath The local directory to download the directory into.
+ @param delegate A delegate object that will call update methods during the download.
+ 
+ @return A directory download task object ready to be started.
+ */
+- (TOSMBSessionDirectoryDownloadTask *)downloadTaskForDirectoryAtPath:(NSString *)path
+                                                      destinationPath:(NSString *)destinationPath
+                                                             delegate:(id <TOSMBSessionBatchDownloadTaskDelegate>)delegate;
+
+/**
+ Same as above, creates a task object for downloading a directory and everything inside it.
+ 
+ @param path The path on the SMB device of the directory to download.
+ @param destinationPath The local directory to download the directory into.
+ @param progressHandler A block periodically called with the progress of the whole directory.
+ @param completionHandler A block called once every file has been attempted. Check `fileErrors` for any that failed.
+ @param failHandler A block called if the directory couldn't be downloaded at all
+ 
+ @return A directory download task object ready to be started.
+ */
+- (TOSMBSessionDirectoryDownloadTask *)downloadTaskForDirectoryAtPath:(NSString *)path
+                                                      destinationPath:(NSString *)destinationPath
+                                                      progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                    completionHandler:(void (^)(void))completionHandler
+                                                          failHandler:(void (^)(NSError *error))failHandler;
+
 /**
  Creates an upload task object for asynchronously uploading a file to disk.
  
@@ -163,6 +559,74 @@
                                   completionHandler:(void (^)(void))completionHandler
                                         failHandler:(void (^)(NSError *error))failHandler;
 
+/**
+ Creates an upload task object for asynchronously uploading a local file. The file is read in chunks
+ as it is sent, so it is never loaded into memory in its entirety.
+ 
+ @param path The destination path on the SMB device for the file.
+ @param sourceFilePath The path of the local file to upload.
+ @param completionHandler A block called once the upload has completed.
+ @param failHandler A block called if the upload fails
+ 
+ @return An upload task object ready to be started.
+ */
+- (TOSMBSessionUploadTask *)uploadTaskForFileAtPath:(NSString *)path
+                                     fromFileAtPath:(NSString *)sourceFilePath
+                                    progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                  completionHandler:(void (^)(void))completionHandler
+                                        failHandler:(void (^)(NSError *error))failHandler;
+
+/**
+ Creates an upload task object for asynchronously uploading the contents of a stream. The stream is
+ read in chunks as it is sent, until it has no more bytes available.
+ 
+ @param path The destination path on the SMB device for the file.
+ @param inputStream The stream to upload. It will be opened if it hasn't been already, and closed once the upload finishes.
+ @param length The number of bytes the stream is expected to provide, for progress reporting, or 0 if it isn't known.
+ @param completionHandler A block called once the upload has completed.
+ @param failHandler A block called if the upload fails
+ 
+ @return An upload task object ready to be started.
+ */
+- (TOSMBSessionUploadTask *)uploadTaskForFileAtPath:(NSString *)path
+                                    fromInputStream:(NSInputStream *)inputStream
+                                             length:(int64_t)length
+                                    progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                  completionHandler:(void (^)(void))completionHandler
+                                        failHandler:(void (^)(NSError *error))failHandler;
+
+/**
+ Creates a task object for uploading a local directory and everything inside it. The directory is recreated
+ inside the destination directory, with the same hierarchy of folders, and its files are then streamed from disk
+ over several connections at once.
+ 
+ @param path The local directory to upload.
+ @param destinationPath The directory on the SMB device to upload the directory into.
+ @param delegate A delegate object that will call update methods during the upload.
+ 
+ @return A directory upload task object ready to be started.
+ */
+- (TOSMBSessionDirectoryUploadTask *)uploadTaskForDirectoryAtPath:(NSString *)path
+                                                  destinationPath:(NSString *)destinationPath
+                                                         delegate:(id <TOSMBSessionDirectoryUploadTaskDelegate>)delegate;
+
+/**
+ Same as above, creates a task object for uploading a local directory and everything inside it.
+ 
+ @param path The local directory to upload.
+ @param destinationPath The directory on the SMB device to upload the directory into.
+ @param progressHandler A block periodically called with the progress of the whole directory.
+ @param completionHandler A block called once every file has been attempted. Check `fileErrors` for any that failed.
+ @param failHandler A block called if the directory couldn't be uploaded at all
+ 
+ @return A directory upload task object ready to be started.
+ */
+- (TOSMBSessionDirectoryUploadTask *)uploadTaskForDirectoryAtPath:(NSString *)path
+                                                  destinationPath:(NSString *)destinationPath
+                                                  progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                completionHandler:(void (^)(void))completionHandler
+                                                      failHandler:(void (^)(NSError *error))failHandler;
+
 @end
 
 @interface TOSMBSession (Deprecated)
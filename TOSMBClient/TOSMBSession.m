@@ -22,6 +22,7 @@
 
 #import <arpa/inet.h>
 #import <SystemConfiguration/SystemConfiguration.h>
+#import <stdatomic.h>
 
 #import "TOSMBSessionPrivate.h"
 #import "TOSMBSessionFile.h"
@@ -29,15 +30,27 @@
 #import "TONetBIOSNameService.h"
 #import "TOSMBSessionDownloadTaskPrivate.h"
 #import "TOSMBSessionUploadTaskPrivate.h"
+#import "TOSMBSessionBatchDownloadTaskPrivate.h"
+#import "TOSMBSessionDirectoryDownloadTaskPrivate.h"
+#import "TOSMBSessionDirectoryUploadTaskPrivate.h"
+#import "TOSMBDirectoryCache.h"
+#import "TOSMBDirectoryIndex.h"
+#import "TOSMBSessionDirectoryListingPrivate.h"
+#import "TOSMBSessionTreeWalker.h"
+#import "TOSMBSessionFileReader.h"
+#import "TOSMBSessionFileFilterPrivate.h"
 
 #import "smb_session.h"
 #import "smb_share.h"
 #import "smb_stat.h"
+#import "smb_file.h"
+#import "smb_dir.h"
 
 @interface TOSMBSession ()
 
-/* The session pointer responsible for this object. */
-@property (nonatomic, assign) smb_session *session;
+/* The connection used for this object's own requests, and its session pointer. */
+@property (nonatomic, strong) TOSMBConnection *connection;
+@property (nonatomic, readonly) smb_session *session;
 
 /* 1 == Guest, 0 == Logged in, -1 == Logged out */
 @property (nonatomic, assign, readwrite) NSInteger guest;
@@ -47,6 +60,8 @@
 
 @property (nonatomic, strong) NSArray <TOSMBSessionDownloadTask *> *downloadTasks;
 @property (nonatomic, strong) NSArray <TOSMBSessionUploadTask *> *uploadTasks;
+@property (nonatomic, strong) NSArray <TOSMBSessionBatchDownloadTask *> *batchDownloadTasks;
+@property (nonatomic, strong) NSArray <TOSMBSessionDirectoryUploadTask *> *directoryUploadTasks;
 
 @property (nonatomic, strong) NSDate *lastRequestDate;
 
@@ -54,17 +69,49 @@
 
 @property (nonatomic, readwrite) dispatch_queue_t serialQueue;
 
+/* Idle, logged-in connections available for reuse by tasks. Only accessed on `serialQueue`. */
+@property (nonatomic, strong) NSMutableArray<TOSMBConnection *> *pooledConnections;
+
+@property (nonatomic, assign, readwrite) NSUInteger connectionPoolHitCount;
+@property (nonatomic, assign, readwrite) NSUInteger connectionPoolMissCount;
+@property (nonatomic, assign, readwrite) NSTimeInterval connectionPoolHandshakeTimeSaved;
+
+@property (nonatomic, strong, readwrite) TOSMBBufferPool *bufferPool;
+@property (nonatomic, strong, readwrite) TOSMBChunkSizer *readChunkSizer;
+@property (nonatomic, strong, readwrite) TOSMBChunkSizer *writeChunkSizer;
+@property (nonatomic, strong, readwrite) TOSMBProgressCoalescer *progressCoalescer;
+
+/* In-memory cache of directory listings */
+@property (nonatomic, strong) TOSMBDirectoryCache *directoryCache;
+
+/* Persistent index of directory listings, stored at `directoryIndexPath` */
+@property (nonatomic, strong) TOSMBDirectoryIndex *directoryIndex;
+@property (nonatomic, assign, readwrite) NSTimeInterval directoryIndexReconcileTime;
+
 /* Connection/Authentication handling */
 - (BOOL)deviceIsOnWiFi;
 - (NSError *)attemptConnection; //Attempt connection for ourselves
 - (NSError *)attemptConnectionWithSessionPointer:(smb_session *)session; //Attempt connection on behalf of concurrent download sessions
 
+/* Connection pooling */
+- (void)purgeExpiredPooledConnections;
+
+/* Directory listings */
+- (NSArray *)fetchContentsOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error; //Always goes to the device
+- (void)refreshCachedContentsOfDirectoryAtFilePath:(NSString *)path;
+- (NSString *)directoryIndexHost; //The name the device's listings are stored under in the index
+
 /* File path parsing */
 - (NSString *)shareNameFromPath:(NSString *)path;
 - (NSString *)filePathExcludingSharePathFromPath:(NSString *)path;
 
 @end
 
+const NSUInteger TOSMBSessionDefaultEnumerationBatchSize = 256;
+
+// The most enumeration batches that may be waiting on the delegate queue at once
+static const long TOSMBSessionMaximumPendingEnumerationBatches = 2;
+
 @implementation TOSMBSession
 
 #pragma mark - Class Creation -
@@ -72,9 +119,26 @@
 {
     if (self = [super init]) {
         _maxTaskOperationCount = NSOperationQueueDefaultMaxConcurrentOperationCount;
-        _session = smb_session_new();
+        _maxPooledConnectionCount = 4;
+        _pooledConnectionIdleTimeout = 60;
+        _pooledConnections = [NSMutableArray array];
+        _directoryCache = [[TOSMBDirectoryCache alloc] init];
+        _bufferPool = [[TOSMBBufferPool alloc] initWithBufferSize:65536 maximumIdleBufferCount:32];
+        
+        //libdsm sends each read and write as a single request, so neither may exceed the 16-bit SMB length field.
+        //Writes also need room for their headers in the same message; anything above 63488 bytes has been seen to crash.
+        _readChunkSizer = [[TOSMBChunkSizer alloc] initWithMinimumChunkSize:8192 maximumChunkSize:65535];
+        _writeChunkSizer = [[TOSMBChunkSizer alloc] initWithMinimumChunkSize:8192 maximumChunkSize:63488];
+        
+        _progressUpdateInterval = 0.1;
+        _progressCoalescer = [[TOSMBProgressCoalescer alloc] init];
+        _progressCoalescer.minimumInterval = _progressUpdateInterval;
+        _delegateQueue = [NSOperationQueue mainQueue];
+        _maximumInMemoryFileSize = 1024 * 1024;
+        _progressCoalescer.delegateQueue = _delegateQueue;
+        _connection = [[TOSMBConnection alloc] init];
         _serialQueue = dispatch_queue_create(nil, DISPATCH_QUEUE_SERIAL);
-        if (_session == NULL) {
+        if (_connection == nil) {
             return nil;
         }
     }
@@ -110,13 +174,6 @@
     return self;
 }
 
-- (void)dealloc
-{
-    if (self.session) {
-        smb_session_destroy(self.session);
-    }
-}
-
 #pragma mark - Authorization -
 - (void)setLoginCredentialsWithUserName:(NSString *)userName password:(NSString *)password
 {
@@ -172,8 +229,8 @@
     // refresh them periodically
     if (self.session == session) {
         if (self.lastRequestDate && [[NSDate date] timeIntervalSinceDate:self.lastRequestDate] > 60) {
-            smb_session_destroy(self.session);
-            self.session = smb_session_new();
+            //Replacing the connection destroys the old session, along with all of its cached share trees
+            self.connection = [[TOSMBConnection alloc] init];
             session = self.session;
             
             self.connected = NO;
@@ -213,6 +270,11 @@
     inet_aton([self.ipAddress cStringUsingEncoding:NSASCIIStringEncoding], &addr);
     const char *hostName = [self.hostName cStringUsingEncoding:NSUTF8StringEncoding];
     
+    //Any share trees connected on a previous connection of this session are no longer valid
+    if (session == self.session) {
+        [self.connection removeAllTreeIDs];
+    }
+    
     //Attempt a connection
     NSInteger result = smb_session_connect(session, hostName, addr.s_addr, SMB_TRANSPORT_TCP);
     if (result != 0) {
@@ -237,8 +299,468 @@
     return nil;
 }
 
+#pragma mark - Connection Pool -
+- (TOSMBConnection *)dequeueConnectionWithError:(NSError **)error
+{
+    //Try and reuse an idle connection that has already been through the connect and login stage
+    __block TOSMBConnection *connection = nil;
+    dispatch_sync(self.serialQueue, ^{
+        [self purgeExpiredPooledConnections];
+        
+        while (self.pooledConnections.count > 0 && connection == nil) {
+            TOSMBConnection *pooledConnection = self.pooledConnections.lastObject;
+            [self.pooledConnections removeLastObject];
+            if (pooledConnection.alive)
+                connection = pooledConnection;
+        }
+        
+        if (connection) {
+            self.connectionPoolHitCount++;
+            self.connectionPoolHandshakeTimeSaved += connection.handshakeDuration;
+        }
+        else {
+            self.connectionPoolMissCount++;
+        }
+    });
+    
+    if (connection)
+        return connection;
+    
+    //Otherwise, create a brand new one and log in
+    connection = [[TOSMBConnection alloc] init];
+    if (connection == nil) {
+        if (error)
+            *error = errorForErrorCode(TOSMBSessionErrorCodeUnableToConnect);
+        return nil;
+    }
+    
+    __block NSError *connectionError = nil;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    dispatch_sync(self.serialQueue, ^{
+        connectionError = [self attemptConnectionWithSessionPointer:connection.session];
+    });
+    connection.handshakeDuration = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    if (connectionError) {
+        if (error)
+            *error = connectionError;
+        return nil;
+    }
+    
+    return connection;
+}
+
+- (void)enqueueConnection:(TOSMBConnection *)connection
+{
+    if (connection == nil)
+        return;
+    
+    //Connections that aren't placed back in the pool are destroyed when they're deallocated
+    dispatch_sync(self.serialQueue, ^{
+        if (connection.alive == NO || (NSInteger)self.pooledConnections.count >= self.maxPooledConnectionCount)
+            return;
+        
+        connection.lastUsedDate = [NSDate date];
+        [self.pooledConnections addObject:connection];
+        [self purgeExpiredPooledConnections];
+    });
+}
+
+- (void)purgeExpiredPooledConnections
+{
+    NSDate *now = [NSDate date];
+    NSIndexSet *expiredIndexes = [self.pooledConnections indexesOfObjectsPassingTest:^BOOL(TOSMBConnection *connection, NSUInteger idx, BOOL *stop) {
+        if (connection.alive == NO)
+            return YES;
+        
+        return ([now timeIntervalSinceDate:connection.lastUsedDate] > self.pooledConnectionIdleTimeout);
+    }];
+    
+    [self.pooledConnections removeObjectsAtIndexes:expiredIndexes];
+}
+
+- (void)closeIdleConnections
+{
+    dispatch_sync(self.serialQueue, ^{
+        [self.pooledConnections removeAllObjects];
+    });
+}
+
+#pragma mark - Tree Walking -
+- (TOSMBSessionTreeWalker *)treeWalkerForDirectoryAtPath:(NSString *)path
+{
+    return [[TOSMBSessionTreeWalker alloc] initWithSession:self rootPath:path];
+}
+
+#pragma mark - File Reading -
+- (TOSMBSessionFileReader *)fileReaderForFileAtPath:(NSString *)path
+{
+    return [[TOSMBSessionFileReader alloc] initWithSession:self filePath:path];
+}
+
+#pragma mark - File Contents -
+- (NSData *)readContentsOfFileAtPath:(NSString *)path
+                          connection:(TOSMBConnection *)connection
+                              buffer:(void *)buffer
+                              length:(NSUInteger)length
+                               error:(NSError **)error
+{
+    NSString *shareName = [self shareNameFromPath:path];
+    NSString *filePath = [self filePathExcludingSharePathFromPath:path];
+    if (shareName.length == 0 || filePath.length == 0) {
+        if (error)
+            *error = errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+        return nil;
+    }
+    
+    NSString *formattedPath = [NSString stringWithFormat:@"\\%@", filePath];
+    formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+    const char *fileCString = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    //The tree is only connected on the first request for each share made over this connection.
+    //Opening the file returns its size too, which saves asking for it separately
+    __block smb_fd fileID = 0;
+    NSError *shareError = [connection performOnShareWithName:shareName treeID:NULL usingBlock:^BOOL(smb_tid treeID) {
+        smb_fopen(connection.session, treeID, fileCString, SMB_MOD_RO, &fileID);
+        return (fileID != 0);
+    }];
+    if (shareError) {
+        if (error)
+            *error = shareError;
+        return nil;
+    }
+    
+    smb_stat fileStat = fileID ? smb_stat_fd(connection.session, fileID) : NULL;
+    if (fileStat == NULL) {
+        if (fileID)
+            smb_fclose(connection.session, fileID);
+        if (error)
+            *error = errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+        return nil;
+    }
+    
+    TOSMBSessionErrorCode errorCode = TOSMBSessionErrorCodeUnknown;
+    uint64_t fileSize = smb_stat_get(fileStat, SMB_STAT_SIZE);
+    if (smb_stat_get(fileStat, SMB_STAT_ISDIR))
+        errorCode = TOSMBSessionErrorCodeDirectoryDownloaded;
+    else if (fileSize > self.maximumInMemoryFileSize || (buffer && fileSize > length))
+        errorCode = TOSMBSessionErrorCodeFileTooLarge;
+    
+    if (errorCode != TOSMBSessionErrorCodeUnknown) {
+        smb_fclose(connection.session, fileID);
+        if (error)
+            *error = errorForErrorCode(errorCode);
+        return nil;
+    }
+    
+    NSMutableData *data = nil;
+    if (buffer == NULL) {
+        data = [NSMutableData dataWithLength:(NSUInteger)fileSize];
+        buffer = data.mutableBytes;
+    }
+    
+    TOSMBChunkSizer *chunkSizer = self.readChunkSizer;
+    uint64_t bytesReceived = 0;
+    ssize_t bytesRead = 0;
+    while (bytesReceived < fileSize) {
+        size_t chunkSize = (size_t)MIN((uint64_t)chunkSizer.chunkSize, fileSize - bytesReceived);
+        CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+        bytesRead = smb_fread(connection.session, fileID, (char *)buffer + bytesReceived, chunkSize);
+        if (bytesRead <= 0)
+            break;
+        
+        bytesReceived += bytesRead;
+        [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                           requestedBytes:chunkSize
+                                 duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                endOfFile:(bytesReceived >= fileSize)];
+    }
+    
+    if (bytesRead < 0) {
+        connection.invalid = YES;
+        if (error)
+            *error = errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed);
+        return nil;
+    }
+    
+    smb_fclose(connection.session, fileID);
+    
+    if (data) {
+        data.length = (NSUInteger)bytesReceived;
+        return data;
+    }
+    
+    return [NSData dataWithBytesNoCopy:buffer length:(NSUInteger)bytesReceived freeWhenDone:NO];
+}
+
+- (NSData *)requestContentsOfFileAtPath:(NSString *)path error:(NSError **)error
+{
+    TOSMBConnection *connection = [self dequeueConnectionWithError:error];
+    if (connection == nil)
+        return nil;
+    
+    NSData *data = [self readContentsOfFileAtPath:path connection:connection buffer:NULL length:0 error:error];
+    [self enqueueConnection:connection];
+    return data;
+}
+
+- (NSInteger)readContentsOfFileAtPath:(NSString *)path intoBuffer:(void *)buffer length:(NSUInteger)length error:(NSError **)error
+{
+    TOSMBConnection *connection = [self dequeueConnectionWithError:error];
+    if (connection == nil)
+        return -1;
+    
+    NSData *data = [self readContentsOfFileAtPath:path connection:connection buffer:buffer length:length error:error];
+    [self enqueueConnection:connection];
+    return data ? (NSInteger)data.length : -1;
+}
+
+- (NSDictionary<NSString *, NSData *> *)requestContentsOfFilesAtPaths:(NSArray<NSString *> *)paths
+                                                              errors:(NSDictionary<NSString *, NSError *> **)errors
+{
+    NSMutableDictionary<NSString *, NSData *> *contents = [NSMutableDictionary dictionaryWithCapacity:paths.count];
+    NSMutableDictionary<NSString *, NSError *> *fileErrors = [NSMutableDictionary dictionary];
+    
+    //Every file is read over the same connection, so each share's tree is only connected to once
+    NSError *error = nil;
+    TOSMBConnection *connection = [self dequeueConnectionWithError:&error];
+    
+    for (NSString *path in paths) {
+        //Get a fresh connection if the last one dropped partway through
+        if (connection.isInvalid) {
+            [self enqueueConnection:connection];
+            connection = [self dequeueConnectionWithError:&error];
+        }
+        
+        if (connection == nil) {
+            fileErrors[path] = error;
+            continue;
+        }
+        
+        NSError *fileError = nil;
+        NSData *data = [self readContentsOfFileAtPath:path connection:connection buffer:NULL length:0 error:&fileError];
+        if (data)
+            contents[path] = data;
+        else
+            fileErrors[path] = fileError;
+    }
+    
+    if (connection)
+        [self enqueueConnection:connection];
+    
+    if (errors)
+        *errors = fileErrors.count ? fileErrors : nil;
+    
+    return contents;
+}
+
+- (void)requestContentsOfFileAtPath:(NSString *)path success:(void (^)(NSData *))successHandler error:(void (^)(NSError *))errorHandler
+{
+    NSBlockOperation *operation = [[NSBlockOperation alloc] init];
+    
+    __weak typeof(self) weakSelf = self;
+    __weak NSBlockOperation *weakOperation = operation;
+    
+    id operationBlock = ^{
+        if (weakOperation.cancelled) { return; }
+        
+        NSError *error = nil;
+        NSData *data = [weakSelf requestContentsOfFileAtPath:path error:&error];
+        
+        if (weakOperation.cancelled) { return; }
+        
+        if (error) {
+            if (errorHandler) {
+                [weakSelf performDelegateBlock:^{ errorHandler(error); }];
+            }
+        }
+        else {
+            if (successHandler) {
+                [weakSelf performDelegateBlock:^{ successHandler(data); }];
+            }
+        }
+    };
+    [operation addExecutionBlock:operationBlock];
+    [self.dataQueue addOperation:operation];
+}
+
+- (void)requestContentsOfFilesAtPaths:(NSArray<NSString *> *)paths
+                    completionHandler:(void (^)(NSDictionary<NSString *, NSData *> *, NSDictionary<NSString *, NSError *> *))completionHandler
+{
+    NSBlockOperation *operation = [[NSBlockOperation alloc] init];
+    
+    __weak typeof(self) weakSelf = self;
+    __weak NSBlockOperation *weakOperation = operation;
+    
+    id operationBlock = ^{
+        if (weakOperation.cancelled) { return; }
+        
+        NSDictionary *errors = nil;
+        NSDictionary *contents = [weakSelf requestContentsOfFilesAtPaths:paths errors:&errors];
+        
+        if (weakOperation.cancelled) { return; }
+        
+        if (completionHandler) {
+            [weakSelf performDelegateBlock:^{ completionHandler(contents, errors); }];
+        }
+    };
+    [operation addExecutionBlock:operationBlock];
+    [self.dataQueue addOperation:operation];
+}
+
+#pragma mark - Directory Creation -
+- (NSError *)createDirectoryAtPath:(NSString *)path connection:(TOSMBConnection *)connection
+{
+    NSString *shareName = [self shareNameFromPath:path];
+    NSString *formattedPath = [NSString stringWithFormat:@"\\%@", [self filePathExcludingSharePathFromPath:path]];
+    formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+    const char *directoryCString = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    smb_tid treeID = 0;
+    __block int result = 0;
+    NSError *shareError = [connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        result = smb_directory_create(connection.session, shareTreeID, directoryCString);
+        return (result == 0);
+    }];
+    if (shareError)
+        return shareError;
+    
+    //A directory that's already there is as good as a new one
+    if (result != 0) {
+        smb_stat directoryStat = smb_fstat(connection.session, treeID, directoryCString);
+        BOOL exists = (directoryStat && smb_stat_get(directoryStat, SMB_STAT_ISDIR));
+        if (directoryStat)
+            smb_stat_destroy(directoryStat);
+        
+        if (exists == NO)
+            return errorForErrorCode(TOSMBSessionErrorCodeDirectoryCreationFailed);
+    }
+    
+    //Make sure the next listing of the parent picks up the new directory
+    [self invalidateCachedContentsOfDirectoryAtFilePath:[path stringByDeletingLastPathComponent]];
+    
+    return nil;
+}
+
+- (BOOL)createDirectoryAtPath:(NSString *)path error:(NSError **)error
+{
+    TOSMBConnection *connection = [self dequeueConnectionWithError:error];
+    if (connection == nil)
+        return NO;
+    
+    NSError *directoryError = [self createDirectoryAtPath:path connection:connection];
+    [self enqueueConnection:connection];
+    
+    if (directoryError && error)
+        *error = directoryError;
+    
+    return (directoryError == nil);
+}
+
 #pragma mark - Data Requests -
 - (NSArray *)requestContentsOfDirectoryAtFilePath:(NSString *)path error:(NSError **)error
+{
+    return [self requestContentsOfDirectoryAtFilePath:path filter:nil error:error];
+}
+
+- (NSArray *)requestContentsOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error
+{
+    TOSMBDirectoryIndex *index = self.directoryIndex;
+    
+    //Filtered listings are only a subset of the directory, so they bypass the cache
+    if ((self.directoryCacheTimeout <= 0 && index == nil) || filter)
+        return [self fetchContentsOfDirectoryAtFilePath:path filter:filter error:error];
+    
+    //Serve the listing from the cache if we can (Including expired listings if we're allowed to refresh them later)
+    BOOL expired = NO;
+    BOOL allowExpired = (self.returnsStaleDirectoryContents || index != nil);
+    NSArray *files = [self.directoryCache filesForPath:path allowingExpired:allowExpired expired:&expired];
+    
+    //Failing that, fall back to the listing we saw last time, and reconcile it with the device in the background
+    if (files == nil && index) {
+        files = [index filesForPath:path host:self.directoryIndexHost session:self];
+        if (files) {
+            [self.directoryCache setFiles:files forPath:path date:[NSDate distantPast]];
+            expired = YES;
+        }
+    }
+    
+    if (files) {
+        if (expired)
+            [self refreshCachedContentsOfDirectoryAtFilePath:path];
+        
+        return files.count ? files : nil;
+    }
+    
+    NSError *resultError = nil;
+    files = [self fetchContentsOfDirectoryAtFilePath:path filter:nil error:&resultError];
+    if (resultError) {
+        if (error)
+            *error = resultError;
+        
+        return nil;
+    }
+    
+    //Empty directories are cached too, so they don't keep going back to the network
+    [self.directoryCache setFiles:files ?: @[] forPath:path];
+    [index setFiles:files ?: @[] forPath:path host:self.directoryIndexHost];
+    return files;
+}
+
+- (void)refreshCachedContentsOfDirectoryAtFilePath:(NSString *)path
+{
+    if ([self.directoryCache beginRefreshForPath:path] == NO)
+        return;
+    
+    __weak typeof(self) weakSelf = self;
+    [self.dataQueue addOperationWithBlock:^{
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        
+        NSError *error = nil;
+        NSArray *files = [weakSelf fetchContentsOfDirectoryAtFilePath:path filter:nil error:&error];
+        if (error == nil) {
+            [weakSelf.directoryCache setFiles:files ?: @[] forPath:path];
+            
+            TOSMBDirectoryIndex *index = weakSelf.directoryIndex;
+            if (index) {
+                [index setFiles:files ?: @[] forPath:path host:weakSelf.directoryIndexHost];
+                weakSelf.directoryIndexReconcileTime += CFAbsoluteTimeGetCurrent() - startTime;
+            }
+        }
+        
+        [weakSelf.directoryCache endRefreshForPath:path];
+        
+        if (error || weakSelf == nil)
+            return;
+        
+        TOSMBSession *session = weakSelf;
+        [session performDelegateBlock:^{
+            [[NSNotificationCenter defaultCenter] postNotificationName:TOSMBSessionDidRefreshDirectoryContentsNotification
+                                                                object:session
+                                                              userInfo:@{TOSMBSessionDirectoryPathKey: path ?: @"/"}];
+        }];
+    }];
+}
+
+- (void)invalidateCachedContentsOfDirectoryAtFilePath:(NSString *)path
+{
+    [self.directoryCache removeFilesForPath:path];
+    [self.directoryIndex removeFilesForPath:path host:self.directoryIndexHost];
+}
+
+- (void)removeAllCachedDirectoryContents
+{
+    [self.directoryCache removeAllFiles];
+    [self.directoryIndex removeAllFilesForHost:self.directoryIndexHost];
+}
+
+- (NSString *)directoryIndexHost
+{
+    NSString *host = self.hostName.length ? self.hostName : self.ipAddress;
+    return host.lowercaseString ?: @"";
+}
+
+- (NSArray *)fetchContentsOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error
 {
     //Attempt a connection attempt (If it has not already been done)
     NSError *resultError = [self attemptConnection];
@@ -282,22 +804,38 @@
     //Replace any backslashes with forward slashes
     path = [path stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
     
-    //Work out just the share name from the path (The first directory in the string)
-    NSString *shareName = [self shareNameFromPath:path];
+    NSMutableArray *fileList = [NSMutableArray array];
+    resultError = [self enumerateStatsOfDirectoryAtFilePath:path filter:filter connection:self.connection usingBlock:^(smb_stat stat, BOOL *stop) {
+        TOSMBSessionFile *file = [[TOSMBSessionFile alloc] initWithStat:stat session:self parentDirectoryFilePath:path];
+        [fileList addObject:file];
+    }];
     
-    //Connect to that share
-    //If not, make a new connection
-    const char *cStringName = [shareName cStringUsingEncoding:NSUTF8StringEncoding];
-    smb_tid shareID = -1;
-    if (smb_tree_connect(self.session, cStringName, &shareID) != 0) {
-        if (error) {
-            resultError = errorForErrorCode(TOSMBSessionErrorCodeShareConnectionFailed);
+    if (resultError) {
+        if (error)
             *error = resultError;
-        }
         
         return nil;
     }
     
+    if (fileList.count == 0)
+        return nil;
+    
+    return [fileList sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"name" ascending:YES]]];
+}
+
+- (NSError *)enumerateStatsOfDirectoryAtFilePath:(NSString *)path connection:(TOSMBConnection *)connection usingBlock:(void (^)(smb_stat, BOOL *))block
+{
+    return [self enumerateStatsOfDirectoryAtFilePath:path filter:nil connection:connection usingBlock:block];
+}
+
+- (NSError *)enumerateStatsOfDirectoryAtFilePath:(NSString *)path
+                                          filter:(TOSMBSessionFileFilter *)filter
+                                      connection:(TOSMBConnection *)connection
+                                      usingBlock:(void (^)(smb_stat, BOOL *))block
+{
+    //Work out just the share name from the path (The first directory in the string)
+    NSString *shareName = [self shareNameFromPath:path];
+    
     //work out the remainder of the file path and create the search query
     NSString *relativePath = [self filePathExcludingSharePathFromPath:path];
     //prepend double backslashes
@@ -308,38 +846,279 @@
     if (![[relativePath substringFromIndex:relativePath.length-1] isEqualToString:@"\\"])
         relativePath = [relativePath stringByAppendingString:@"\\"];
     
-    //Add the wildcard symbol for everything in this folder
-    relativePath = [relativePath stringByAppendingString:@"*"]; //wildcard to search for all files
+    //Add the wildcard pattern, so the device only sends back the entries we're after
+    relativePath = [relativePath stringByAppendingString:filter ? filter.searchPattern : @"*"];
     
-    //Query for a list of files in this directory
-    smb_stat_list statList = smb_find(self.session, shareID, relativePath.UTF8String);
-    size_t listCount = smb_stat_list_count(statList);
-    if (listCount == 0)
-        return nil;
+    //Query for a list of files in this directory, reusing the tree ID of the share if we've already connected to it
+    __block smb_stat_list statList = NULL;
+    NSError *error = [connection performOnShareWithName:shareName treeID:NULL usingBlock:^BOOL(smb_tid shareID) {
+        statList = smb_find(connection.session, shareID, relativePath.UTF8String);
+        return (statList != NULL);
+    }];
+    if (error)
+        return error;
     
-    NSMutableArray *fileList = [NSMutableArray array];
+    if (statList == NULL)
+        return nil;
     
-    for (NSInteger i = 0; i < listCount; i++) {
-        smb_stat item = smb_stat_list_at(statList, i);
+    //Walk the list with a cursor, rather than with smb_stat_list_at(), which re-walks it from the start each time
+    BOOL stop = NO;
+    for (smb_stat item = statList; item != NULL && stop == NO; item = smb_stat_list_next(item)) {
         const char* name = smb_stat_name(item);
-        if (name[0] == '.') { //skip hidden files
+        if (name == NULL || name[0] == '.') { //skip hidden files
             continue;
         }
         
-        TOSMBSessionFile *file = [[TOSMBSessionFile alloc] initWithStat:item session:self parentDirectoryFilePath:path];
-        [fileList addObject:file];
+        if (filter && [filter matchesStat:item] == NO)
+            continue;
+        
+        block(item, &stop);
     }
     smb_stat_list_destroy(statList);
-    smb_tree_disconnect(self.session, shareID);
     
-    if (fileList.count == 0)
+    return nil;
+}
+
+#pragma mark - Compact Listings -
+- (TOSMBSessionDirectoryListing *)requestListingOfDirectoryAtFilePath:(NSString *)path error:(NSError **)error
+{
+    return [self requestListingOfDirectoryAtFilePath:path filter:nil error:error];
+}
+
+- (TOSMBSessionDirectoryListing *)requestListingOfDirectoryAtFilePath:(NSString *)path filter:(TOSMBSessionFileFilter *)filter error:(NSError **)error
+{
+    //Attempt a connection attempt (If it has not already been done)
+    NSError *resultError = [self attemptConnection];
+    if (resultError) {
+        if (error)
+            *error = resultError;
+        
         return nil;
+    }
     
-    return [fileList sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"name" ascending:YES]]];
+    //The root of the device lists the network shares
+    if (path.length == 0 || [path isEqualToString:@"/"]) {
+        TOSMBSessionDirectoryListing *listing = [[TOSMBSessionDirectoryListing alloc] initWithSession:self directoryPath:@"/"];
+        
+        smb_share_list list = NULL;
+        size_t shareCount = 0;
+        BOOL appended = YES;
+        smb_share_get_list(self.session, &list, &shareCount);
+        for (size_t i = 0; i < shareCount && appended; i++) {
+            const char *shareName = smb_share_list_at(list, i);
+            
+            //Skip system shares suffixed by '$'
+            size_t length = shareName ? strlen(shareName) : 0;
+            if (length == 0 || shareName[length-1] == '$')
+                continue;
+            
+            appended = [listing appendShareName:shareName];
+        }
+        
+        if (list)
+            smb_share_list_destroy(list);
+        
+        if (appended == NO) {
+            if (error)
+                *error = errorForErrorCode(TOSMBSessionErrorCodeUnknown);
+            
+            return nil;
+        }
+        
+        [listing sortByName];
+        return listing;
+    }
+    
+    path = [path stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+    
+    //Copy the values of each entry straight into the listing, without creating any objects
+    TOSMBSessionDirectoryListing *listing = [[TOSMBSessionDirectoryListing alloc] initWithSession:self directoryPath:path];
+    __block BOOL appended = YES;
+    resultError = [self enumerateStatsOfDirectoryAtFilePath:path filter:filter connection:self.connection usingBlock:^(smb_stat stat, BOOL *stop) {
+        appended = [listing appendStat:stat];
+        *stop = (appended == NO);
+    }];
+    
+    //Running out of memory part way through would otherwise hand back a listing with entries missing
+    if (resultError == nil && appended == NO)
+        resultError = errorForErrorCode(TOSMBSessionErrorCodeUnknown);
+    
+    if (resultError) {
+        if (error)
+            *error = resultError;
+        
+        return nil;
+    }
+    
+    [listing sortByName];
+    return listing;
+}
+
+- (void)requestListingOfDirectoryAtFilePath:(NSString *)path success:(void (^)(TOSMBSessionDirectoryListing *))successHandler error:(void (^)(NSError *))errorHandler
+{
+    NSBlockOperation *operation = [[NSBlockOperation alloc] init];
+    
+    __weak typeof(self) weakSelf = self;
+    __weak NSBlockOperation *weakOperation = operation;
+    
+    id operationBlock = ^{
+        if (weakOperation.cancelled) { return; }
+        
+        NSError *error = nil;
+        TOSMBSessionDirectoryListing *listing = [weakSelf requestListingOfDirectoryAtFilePath:path error:&error];
+        
+        if (weakOperation.cancelled) { return; }
+        
+        if (error) {
+            if (errorHandler) {
+                [weakSelf performDelegateBlock:^{ errorHandler(error); }];
+            }
+        }
+        else {
+            if (successHandler) {
+                [weakSelf performDelegateBlock:^{ successHandler(listing); }];
+            }
+        }
+    };
+    [operation addExecutionBlock:operationBlock];
+    [self.dataQueue addOperation:operation];
+}
+
+#pragma mark - Batched Enumeration -
+- (BOOL)enumerateContentsOfDirectoryAtFilePath:(NSString *)path
+                                     batchSize:(NSUInteger)batchSize
+                                    usingBlock:(void (^)(NSArray<TOSMBSessionFile *> *, BOOL *))block
+                                         error:(NSError **)error
+{
+    if (block == nil)
+        return YES;
+    
+    if (batchSize == 0)
+        batchSize = TOSMBSessionDefaultEnumerationBatchSize;
+    
+    //Attempt a connection attempt (If it has not already been done)
+    NSError *resultError = [self attemptConnection];
+    if (resultError) {
+        if (error)
+            *error = resultError;
+        
+        return NO;
+    }
+    
+    //The list of shares is always small, so simply split up the regular result
+    if (path.length == 0 || [path isEqualToString:@"/"]) {
+        NSArray *shares = [self fetchContentsOfDirectoryAtFilePath:path filter:nil error:&resultError];
+        if (resultError) {
+            if (error)
+                *error = resultError;
+            
+            return NO;
+        }
+        
+        BOOL stop = NO;
+        for (NSUInteger i = 0; i < shares.count && stop == NO; i += batchSize) {
+            block([shares subarrayWithRange:NSMakeRange(i, MIN(batchSize, shares.count - i))], &stop);
+        }
+        
+        return YES;
+    }
+    
+    path = [path stringByReplacingOccurrencesOfString:@"\\" withString:@"/"];
+    
+    //Only ever hold onto one batch of file objects at a time
+    __block NSMutableArray *batch = [NSMutableArray arrayWithCapacity:batchSize];
+    __block BOOL stopped = NO;
+    resultError = [self enumerateStatsOfDirectoryAtFilePath:path connection:self.connection usingBlock:^(smb_stat stat, BOOL *stop) {
+        [batch addObject:[[TOSMBSessionFile alloc] initWithStat:stat session:self parentDirectoryFilePath:path]];
+        if (batch.count < batchSize)
+            return;
+        
+        @autoreleasepool {
+            NSArray *files = batch;
+            batch = [NSMutableArray arrayWithCapacity:batchSize];
+            block(files, &stopped);
+        }
+        
+        *stop = stopped;
+    }];
+    
+    if (resultError) {
+        if (error)
+            *error = resultError;
+        
+        return NO;
+    }
+    
+    if (batch.count > 0 && stopped == NO)
+        block(batch, &stopped);
+    
+    return YES;
+}
+
+- (void)enumerateContentsOfDirectoryAtFilePath:(NSString *)path
+                                     batchSize:(NSUInteger)batchSize
+                                  batchHandler:(void (^)(NSArray<TOSMBSessionFile *> *, BOOL *))batchHandler
+                             completionHandler:(void (^)(NSError *))completionHandler
+{
+    NSBlockOperation *operation = [[NSBlockOperation alloc] init];
+    
+    __weak typeof(self) weakSelf = self;
+    __weak NSBlockOperation *weakOperation = operation;
+    
+    id operationBlock = ^{
+        if (weakOperation.cancelled) { return; }
+        
+        //Let a couple of batches queue up on the delegate queue at most, so memory stays bounded
+        //even if the delegate queue is slower at consuming them than we are at reading them
+        dispatch_semaphore_t pendingBatches = dispatch_semaphore_create(TOSMBSessionMaximumPendingEnumerationBatches);
+        
+        //Set on the delegate queue, but checked by this thread before each batch
+        __block atomic_bool stopRequested = NO;
+        
+        NSError *error = nil;
+        [weakSelf enumerateContentsOfDirectoryAtFilePath:path batchSize:batchSize usingBlock:^(NSArray *files, BOOL *stop) {
+            dispatch_semaphore_wait(pendingBatches, DISPATCH_TIME_FOREVER);
+            
+            if (stopRequested || weakOperation.cancelled) {
+                dispatch_semaphore_signal(pendingBatches);
+                *stop = YES;
+                return;
+            }
+            
+            [weakSelf performDelegateBlock:^{
+                if (stopRequested == NO && batchHandler) {
+                    BOOL stopBatches = NO;
+                    batchHandler(files, &stopBatches);
+                    if (stopBatches)
+                        stopRequested = YES;
+                }
+                
+                dispatch_semaphore_signal(pendingBatches);
+            }];
+        } error:&error];
+        
+        if (weakOperation.cancelled) { return; }
+        
+        if (completionHandler) {
+            [weakSelf performDelegateBlock:^{ completionHandler(error); }];
+        }
+    };
+    [operation addExecutionBlock:operationBlock];
+    [self.dataQueue addOperation:operation];
 }
 
 - (void)requestContentsOfDirectoryAtFilePath:(NSString *)path success:(void (^)(NSArray *))successHandler error:(void (^)(NSError *))errorHandler
 {
+    [self requestContentsOfDirectoryAtFilePath:path filter:nil success:successHandler error:errorHandler];
+}
+
+- (void)requestContentsOfDirectoryAtFilePath:(NSString *)path
+                                      filter:(TOSMBSessionFileFilter *)filter
+                                     success:(void (^)(NSArray *))successHandler
+                                       error:(void (^)(NSError *))errorHandler
+{
+    filter = [filter copy];
+    
     NSBlockOperation *operation = [[NSBlockOperation alloc] init];
     
     __weak typeof(self) weakSelf = self;
@@ -349,18 +1128,18 @@
         if (weakOperation.cancelled) { return; }
         
         NSError *error = nil;
-        NSArray *files = [weakSelf requestContentsOfDirectoryAtFilePath:path error:&error];
+        NSArray *files = [weakSelf requestContentsOfDirectoryAtFilePath:path filter:filter error:&error];
         
         if (weakOperation.cancelled) { return; }
         
         if (error) {
             if (errorHandler) {
-                [[NSOperationQueue mainQueue] addOperationWithBlock:^{ errorHandler(error); }];
+                [weakSelf performDelegateBlock:^{ errorHandler(error); }];
             }
         }
         else {
             if (successHandler) {
-                [[NSOperationQueue mainQueue] addOperationWithBlock:^{ successHandler(files); }];
+                [weakSelf performDelegateBlock:^{ successHandler(files); }];
             }
         }
     };
@@ -393,6 +1172,66 @@
     return task;
 }
 
+- (TOSMBSessionDownloadTask *)downloadTaskForByteRanges:(NSArray<NSValue *> *)ranges
+                                           ofFileAtPath:(NSString *)path
+                                        destinationPath:(NSString *)destinationPath
+                                        progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                      completionHandler:(void (^)(NSString *filePath))completionHandler
+                                            failHandler:(void (^)(NSError *error))failHandler
+{
+    TOSMBSessionDownloadTask *task = [[TOSMBSessionDownloadTask alloc] initWithSession:self filePath:path byteRanges:ranges destinationPath:(destinationPath ?: @"") progressHandler:progressHandler successHandler:completionHandler failHandler:failHandler];
+    self.downloadTasks = [self.downloadTasks ? : @[] arrayByAddingObjectsFromArray:@[task]];
+    return task;
+}
+
+- (TOSMBSessionDownloadTask *)downloadTaskForByteRanges:(NSArray<NSValue *> *)ranges
+                                           ofFileAtPath:(NSString *)path
+                                        progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                      completionHandler:(void (^)(NSArray<NSData *> *data))completionHandler
+                                            failHandler:(void (^)(NSError *error))failHandler
+{
+    TOSMBSessionDownloadTask *task = [[TOSMBSessionDownloadTask alloc] initWithSession:self filePath:path byteRanges:ranges destinationPath:nil progressHandler:progressHandler successHandler:completionHandler failHandler:failHandler];
+    self.downloadTasks = [self.downloadTasks ? : @[] arrayByAddingObjectsFromArray:@[task]];
+    return task;
+}
+
+#pragma mark - Batch Download Tasks -
+- (TOSMBSessionBatchDownloadTask *)batchDownloadTaskForFilesAtPaths:(NSArray<NSString *> *)paths destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionBatchDownloadTaskDelegate>)delegate
+{
+    TOSMBSessionBatchDownloadTask *task = [[TOSMBSessionBatchDownloadTask alloc] initWithSession:self filePaths:paths destinationPath:destinationPath delegate:delegate];
+    self.batchDownloadTasks = [self.batchDownloadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
+- (TOSMBSessionBatchDownloadTask *)batchDownloadTaskForFilesAtPaths:(NSArray<NSString *> *)paths
+                                                    destinationPath:(NSString *)destinationPath
+                                                    progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                  completionHandler:(void (^)(void))completionHandler
+                                                        failHandler:(void (^)(NSError *error))failHandler
+{
+    TOSMBSessionBatchDownloadTask *task = [[TOSMBSessionBatchDownloadTask alloc] initWithSession:self filePaths:paths destinationPath:destinationPath progressHandler:progressHandler successHandler:completionHandler failHandler:failHandler];
+    self.batchDownloadTasks = [self.batchDownloadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
+- (TOSMBSessionDirectoryDownloadTask *)downloadTaskForDirectoryAtPath:(NSString *)path destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionBatchDownloadTaskDelegate>)delegate
+{
+    TOSMBSessionDirectoryDownloadTask *task = [[TOSMBSessionDirectoryDownloadTask alloc] initWithSession:self directoryPath:path destinationPath:destinationPath delegate:delegate];
+    self.batchDownloadTasks = [self.batchDownloadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
+- (TOSMBSessionDirectoryDownloadTask *)downloadTaskForDirectoryAtPath:(NSString *)path
+                                                      destinationPath:(NSString *)destinationPath
+                                                      progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                    completionHandler:(void (^)(void))completionHandler
+                                                          failHandler:(void (^)(NSError *error))failHandler
+{
+    TOSMBSessionDirectoryDownloadTask *task = [[TOSMBSessionDirectoryDownloadTask alloc] initWithSession:self directoryPath:path destinationPath:destinationPath progressHandler:progressHandler successHandler:completionHandler failHandler:failHandler];
+    self.batchDownloadTasks = [self.batchDownloadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
 #pragma mark - Upload Tasks -
 - (TOSMBSessionUploadTask *)uploadTaskForFileAtPath:(NSString *)path data:(NSData *)data progressHandler:(void (^)(uint64_t, uint64_t))progressHandler completionHandler:(void (^)(void))completionHandler failHandler:(void (^)(NSError *))failHandler {
     TOSMBSessionUploadTask *task = [[TOSMBSessionUploadTask alloc] initWithSession:self
@@ -407,6 +1246,51 @@
     return task;
 }
 
+- (TOSMBSessionUploadTask *)uploadTaskForFileAtPath:(NSString *)path fromFileAtPath:(NSString *)sourceFilePath progressHandler:(void (^)(uint64_t, uint64_t))progressHandler completionHandler:(void (^)(void))completionHandler failHandler:(void (^)(NSError *))failHandler {
+    TOSMBSessionUploadTask *task = [[TOSMBSessionUploadTask alloc] initWithSession:self
+                                                                              path:path
+                                                                    sourceFilePath:sourceFilePath
+                                                                   progressHandler:progressHandler
+                                                                    successHandler:completionHandler
+                                                                       failHandler:failHandler];
+    
+    self.uploadTasks = [self.uploadTasks ?: @[] arrayByAddingObject:task];
+    
+    return task;
+}
+
+- (TOSMBSessionUploadTask *)uploadTaskForFileAtPath:(NSString *)path fromInputStream:(NSInputStream *)inputStream length:(int64_t)length progressHandler:(void (^)(uint64_t, uint64_t))progressHandler completionHandler:(void (^)(void))completionHandler failHandler:(void (^)(NSError *))failHandler {
+    TOSMBSessionUploadTask *task = [[TOSMBSessionUploadTask alloc] initWithSession:self
+                                                                              path:path
+                                                                       inputStream:inputStream
+                                                                            length:length
+                                                                   progressHandler:progressHandler
+                                                                    successHandler:completionHandler
+                                                                       failHandler:failHandler];
+    
+    self.uploadTasks = [self.uploadTasks ?: @[] arrayByAddingObject:task];
+    
+    return task;
+}
+
+- (TOSMBSessionDirectoryUploadTask *)uploadTaskForDirectoryAtPath:(NSString *)path destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionDirectoryUploadTaskDelegate>)delegate
+{
+    TOSMBSessionDirectoryUploadTask *task = [[TOSMBSessionDirectoryUploadTask alloc] initWithSession:self directoryPath:path destinationPath:destinationPath delegate:delegate];
+    self.directoryUploadTasks = [self.directoryUploadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
+- (TOSMBSessionDirectoryUploadTask *)uploadTaskForDirectoryAtPath:(NSString *)path
+                                                  destinationPath:(NSString *)destinationPath
+                                                  progressHandler:(void (^)(uint64_t totalBytesWritten, uint64_t totalBytesExpected))progressHandler
+                                                completionHandler:(void (^)(void))completionHandler
+                                                      failHandler:(void (^)(NSError *error))failHandler
+{
+    TOSMBSessionDirectoryUploadTask *task = [[TOSMBSessionDirectoryUploadTask alloc] initWithSession:self directoryPath:path destinationPath:destinationPath progressHandler:progressHandler successHandler:completionHandler failHandler:failHandler];
+    self.directoryUploadTasks = [self.directoryUploadTasks ?: @[] arrayByAddingObject:task];
+    return task;
+}
+
 #pragma mark - String Parsing -
 - (NSString *)shareNameFromPath:(NSString *)path
 {
@@ -452,6 +1336,11 @@
 }
 
 #pragma mark - Accessors -
+- (smb_session *)session
+{
+    return self.connection.session;
+}
+
 - (NSInteger)guest
 {
     if (self.session == NULL)
@@ -486,6 +1375,101 @@
     self.taskQueue.maxConcurrentOperationCount = maxTaskOperationCount;
 }
 
+- (void)setDirectoryCacheTimeout:(NSTimeInterval)directoryCacheTimeout
+{
+    _directoryCacheTimeout = directoryCacheTimeout;
+    self.directoryCache.timeToLive = directoryCacheTimeout;
+}
+
+- (NSUInteger)bufferPoolAllocationCount
+{
+    return self.bufferPool.allocationCount;
+}
+
+- (NSUInteger)bufferPoolReuseCount
+{
+    return self.bufferPool.reuseCount;
+}
+
+- (void)setDelegateQueue:(NSOperationQueue *)delegateQueue
+{
+    _delegateQueue = delegateQueue ?: [NSOperationQueue mainQueue];
+    self.progressCoalescer.delegateQueue = _delegateQueue;
+}
+
+- (void)performDelegateBlock:(void (^)(void))block
+{
+    [self.delegateQueue addOperationWithBlock:block];
+}
+
+- (void)setProgressUpdateInterval:(NSTimeInterval)progressUpdateInterval
+{
+    _progressUpdateInterval = MAX(0, progressUpdateInterval);
+    self.progressCoalescer.minimumInterval = _progressUpdateInterval;
+}
+
+- (void)setTaskProgressHandler:(void (^)(NSArray<TOSMBSessionTask *> *))taskProgressHandler
+{
+    _taskProgressHandler = [taskProgressHandler copy];
+    self.progressCoalescer.batchHandler = _taskProgressHandler;
+}
+
+- (void)setPreferredChunkSize:(NSUInteger)preferredChunkSize
+{
+    _preferredChunkSize = preferredChunkSize;
+    self.readChunkSizer.preferredChunkSize = preferredChunkSize;
+    self.writeChunkSizer.preferredChunkSize = preferredChunkSize;
+}
+
+- (NSUInteger)currentReadChunkSize
+{
+    return self.readChunkSizer.chunkSize;
+}
+
+- (NSUInteger)currentWriteChunkSize
+{
+    return self.writeChunkSizer.chunkSize;
+}
+
+- (void)setDirectoryIndexPath:(NSString *)directoryIndexPath
+{
+    if (directoryIndexPath == _directoryIndexPath || [directoryIndexPath isEqualToString:_directoryIndexPath])
+        return;
+    
+    _directoryIndexPath = [directoryIndexPath copy];
+    self.directoryIndex = directoryIndexPath.length ? [[TOSMBDirectoryIndex alloc] initWithPath:directoryIndexPath] : nil;
+}
+
+- (uint64_t)directoryIndexSize
+{
+    return self.directoryIndex.size;
+}
+
+- (NSTimeInterval)directoryIndexLoadTime
+{
+    return self.directoryIndex.loadTime;
+}
+
+- (NSUInteger)directoryCacheHitCount
+{
+    return self.directoryCache.hitCount;
+}
+
+- (NSUInteger)directoryCacheMissCount
+{
+    return self.directoryCache.missCount;
+}
+
+- (void)setMaxPooledConnectionCount:(NSInteger)maxPooledConnectionCount
+{
+    _maxPooledConnectionCount = MAX(0, maxPooledConnectionCount);
+    
+    dispatch_sync(self.serialQueue, ^{
+        while ((NSInteger)self.pooledConnections.count > self.maxPooledConnectionCount)
+            [self.pooledConnections removeObjectAtIndex:0];
+    });
+}
+
 @end
 
 @implementation TOSMBSession (Deprecated)
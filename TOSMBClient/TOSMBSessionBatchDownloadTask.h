@@ -0,0 +1,94 @@
+//
+// TOSMBSessionBatchDownloadTask.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionBatchTask.h"
+
+@class TOSMBSessionBatchDownloadTask;
+
+@protocol TOSMBSessionBatchDownloadTaskDelegate <TOSMBSessionTaskDelegate>
+@optional
+
+/**
+ Delegate event that is called as each file finishes downloading.
+ 
+ @param task The batch download task object calling this delegate method.
+ @param sourcePath The path of the file on the SMB device.
+ @param destinationPath The absolute path the file was downloaded to.
+ */
+- (void)batchDownloadTask:(TOSMBSessionBatchDownloadTask *)task
+didFinishDownloadingFileAtPath:(NSString *)sourcePath
+                   toPath:(NSString *)destinationPath;
+
+/**
+ Delegate event that is called when a single file couldn't be downloaded. The rest of the batch carries on.
+ 
+ @param task The batch download task object calling this delegate method.
+ @param sourcePath The path of the file on the SMB device.
+ @param error The error describing why the file couldn't be downloaded.
+ */
+- (void)batchDownloadTask:(TOSMBSessionBatchDownloadTask *)task
+didFailToDownloadFileAtPath:(NSString *)sourcePath
+                    error:(NSError *)error;
+
+/**
+ Delegate event that is called periodically as the batch progresses, with the totals across all of its files.
+ 
+ @param task The batch download task object calling this delegate method.
+ @param bytesWritten The number of bytes written since the last update
+ @param totalBytesReceived The total number of bytes written to disk so far
+ @param totalBytesToReceive The total size of every file opened so far (Or of every file, if their sizes were known up front)
+ */
+- (void)batchDownloadTask:(TOSMBSessionBatchDownloadTask *)task
+            didWriteBytes:(uint64_t)bytesWritten
+       totalBytesReceived:(uint64_t)totalBytesReceived
+totalBytesExpectedToReceive:(uint64_t)totalBytesToReceive;
+
+/**
+ Delegate event that is called once every file in the batch has either been downloaded, or failed.
+ 
+ @param task The batch download task object calling this delegate method.
+ */
+- (void)batchDownloadTaskDidFinishDownloading:(TOSMBSessionBatchDownloadTask *)task;
+
+@end
+
+/**
+ Downloads many files one after the other over a small number of logged-in connections, rather than
+ setting up a new connection, share and task for every file. Each connection stays attached to the shares
+ it has used, and moves straight on to the next file as soon as the last one has been written.
+ 
+ Each file is written to a hidden temporary file next to its destination, and only moved into place once it
+ has downloaded completely. If a file with the same name is already there, a number is appended to the new
+ file's name, as with single download tasks. By default, one connection is used at a time.
+ */
+@interface TOSMBSessionBatchDownloadTask : TOSMBSessionBatchTask
+
+/** The local directory the files are downloaded into. */
+@property (readonly) NSString *destinationDirectoryPath;
+
+/** The number of bytes presently downloaded across all of the files. */
+@property (readonly) int64_t countOfBytesReceived;
+
+/** The total number of bytes expected across all of the files. Files whose size wasn't known up front are added as they are opened. */
+@property (readonly) int64_t countOfBytesExpectedToReceive;
+
+@end
@@ -0,0 +1,317 @@
+//
+// TOSMBSessionBatchDownloadTask.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/time.h>
+
+#import "TOSMBSessionBatchDownloadTaskPrivate.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBChunkSizer.h"
+
+@interface TOSMBSessionBatchDownloadTask ()
+
+@property (nonatomic, copy, readwrite) NSString *destinationDirectoryPath;
+
+/* Local directories already created for the files being downloaded. Guarded by `itemCondition`. */
+@property (nonatomic, strong) NSMutableSet<NSString *> *createdDirectoryPaths;
+
+@end
+
+@implementation TOSMBSessionBatchDownloadTask
+
+@dynamic delegate;
+
+- (instancetype)initWithSession:(TOSMBSession *)session destinationPath:(NSString *)destinationPath
+{
+    if ((self = [super initWithSession:session])) {
+        _destinationDirectoryPath = [destinationPath copy];
+        _createdDirectoryPaths = [NSMutableSet set];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session filePaths:(NSArray<NSString *> *)filePaths destinationPath:(NSString *)destinationPath
+{
+    if ((self = [self initWithSession:session destinationPath:destinationPath])) {
+        //Files keep their paths relative to the deepest folder they all share, so files with the same name
+        //in different folders don't overwrite each other. Files from a single folder land straight in the destination.
+        NSArray<NSString *> *rootComponents = nil;
+        for (NSString *filePath in filePaths) {
+            NSArray<NSString *> *components = filePath.stringByDeletingLastPathComponent.pathComponents;
+            if (rootComponents == nil) {
+                rootComponents = components;
+                continue;
+            }
+            
+            NSUInteger count = 0;
+            while (count < MIN(rootComponents.count, components.count) &&
+                   [rootComponents[count] caseInsensitiveCompare:components[count]] == NSOrderedSame) {
+                count++;
+            }
+            rootComponents = [rootComponents subarrayWithRange:NSMakeRange(0, count)];
+        }
+        
+        NSMutableArray *items = [NSMutableArray arrayWithCapacity:filePaths.count];
+        for (NSString *filePath in filePaths) {
+            NSArray<NSString *> *components = filePath.pathComponents;
+            NSRange relativeRange = NSMakeRange(rootComponents.count, components.count - rootComponents.count);
+            NSString *relativePath = [NSString pathWithComponents:[components subarrayWithRange:relativeRange]];
+            
+            TOSMBSessionBatchItem *item = [[TOSMBSessionBatchItem alloc] init];
+            item.sourcePath = filePath;
+            item.destinationPath = [destinationPath stringByAppendingPathComponent:relativePath];
+            item.expectedSize = -1;
+            [items addObject:item];
+        }
+        
+        [self addItems:items];
+        [self finishAddingItems];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session filePaths:(NSArray<NSString *> *)filePaths destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionBatchDownloadTaskDelegate>)delegate
+{
+    if ((self = [self initWithSession:session filePaths:filePaths destinationPath:destinationPath])) {
+        self.delegate = delegate;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session filePaths:(NSArray<NSString *> *)filePaths destinationPath:(NSString *)destinationPath progressHandler:(id)progressHandler successHandler:(id)successHandler failHandler:(id)failHandler
+{
+    if ((self = [self initWithSession:session filePaths:filePaths destinationPath:destinationPath])) {
+        self.progressHandler = progressHandler;
+        self.successHandler = successHandler;
+        self.failHandler = failHandler;
+    }
+    
+    return self;
+}
+
+#pragma mark - Progress -
+
+- (int64_t)countOfBytesReceived
+{
+    return self.countOfBytesTransferred;
+}
+
+- (int64_t)countOfBytesExpectedToReceive
+{
+    return self.countOfBytesExpectedToTransfer;
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected
+{
+    if (self.delegate && [self.delegate respondsToSelector:@selector(batchDownloadTask:didWriteBytes:totalBytesReceived:totalBytesExpectedToReceive:)])
+        [self.delegate batchDownloadTask:self didWriteBytes:bytes totalBytesReceived:totalBytes totalBytesExpectedToReceive:totalBytesExpected];
+    
+    [super deliverProgressWithBytes:bytes totalBytes:totalBytes totalBytesExpected:totalBytesExpected];
+}
+
+#pragma mark - Feedback Methods -
+
+- (void)deliverCompletionOfFileAtPath:(NSString *)sourcePath destinationPath:(NSString *)destinationPath error:(NSError *)error
+{
+    if (error) {
+        if (self.delegate && [self.delegate respondsToSelector:@selector(batchDownloadTask:didFailToDownloadFileAtPath:error:)])
+            [self.delegate batchDownloadTask:self didFailToDownloadFileAtPath:sourcePath error:error];
+    }
+    else {
+        if (self.delegate && [self.delegate respondsToSelector:@selector(batchDownloadTask:didFinishDownloadingFileAtPath:toPath:)])
+            [self.delegate batchDownloadTask:self didFinishDownloadingFileAtPath:sourcePath toPath:destinationPath];
+    }
+    
+    [super deliverCompletionOfFileAtPath:sourcePath destinationPath:destinationPath error:error];
+}
+
+- (void)deliverSuccess
+{
+    if (self.delegate && [self.delegate respondsToSelector:@selector(batchDownloadTaskDidFinishDownloading:)])
+        [self.delegate batchDownloadTaskDidFinishDownloading:self];
+    
+    [super deliverSuccess];
+}
+
+#pragma mark - Downloading -
+
+- (NSError *)transferItem:(TOSMBSessionBatchItem *)item
+               connection:(TOSMBConnection *)connection
+                   buffer:(char *)buffer
+               bufferSize:(size_t)bufferSize
+                operation:(__weak NSBlockOperation *)weakOperation
+{
+    TOSMBSession *session = self.session;
+    
+    //---------------------------------------------------------------------------------------
+    //Open the file, reusing the tree ID of the share if this connection has used it before
+    
+    NSString *shareName = [session shareNameFromPath:item.sourcePath];
+    NSString *formattedPath = [session filePathExcludingSharePathFromPath:item.sourcePath];
+    formattedPath = [NSString stringWithFormat:@"\\%@",formattedPath];
+    formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+    const char *fileCString = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    smb_tid treeID = 0;
+    __block smb_fd fileID = 0;
+    NSError *error = [connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        smb_fopen(connection.session, shareTreeID, fileCString, SMB_MOD_RO, &fileID);
+        return (fileID != 0);
+    }];
+    if (error)
+        return error;
+    
+    //The open response carries the file's size and dates, so there's no need to ask for them separately
+    smb_stat fileStat = fileID ? smb_stat_fd(connection.session, fileID) : NULL;
+    if (fileStat == NULL) {
+        if (fileID)
+            smb_fclose(connection.session, fileID);
+        return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+    }
+    
+    if (smb_stat_get(fileStat, SMB_STAT_ISDIR)) {
+        smb_fclose(connection.session, fileID);
+        return errorForErrorCode(TOSMBSessionErrorCodeDirectoryDownloaded);
+    }
+    
+    uint64_t fileSize = smb_stat_get(fileStat, SMB_STAT_SIZE);
+    uint64_t modificationTimestamp = smb_stat_get(fileStat, SMB_STAT_MTIME);
+    
+    //Swap any size we were told up front for the real one
+    [self.itemCondition lock];
+    self.countOfBytesExpectedToTransfer += (int64_t)fileSize - MAX(item.expectedSize, (int64_t)0);
+    item.expectedSize = (int64_t)fileSize;
+    [self.itemCondition unlock];
+    
+    //---------------------------------------------------------------------------------------
+    //Write the file next to its destination, and only move it into place once it's complete
+    
+    NSString *directoryPath = [item.destinationPath stringByDeletingLastPathComponent];
+    [self.itemCondition lock];
+    BOOL directoryExists = [self.createdDirectoryPaths containsObject:directoryPath];
+    [self.itemCondition unlock];
+    
+    if (directoryExists == NO) {
+        [[NSFileManager defaultManager] createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:nil];
+        [self.itemCondition lock];
+        [self.createdDirectoryPaths addObject:directoryPath];
+        [self.itemCondition unlock];
+    }
+    
+    NSString *temporaryFileName = [NSString stringWithFormat:@".%@.tosmbdownload", item.destinationPath.lastPathComponent];
+    NSString *temporaryPath = [directoryPath stringByAppendingPathComponent:temporaryFileName];
+    int fileDescriptor = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        smb_fclose(connection.session, fileID);
+        return errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed);
+    }
+    
+    TOSMBChunkSizer *chunkSizer = session.readChunkSizer;
+    uint64_t offset = 0;
+    ssize_t bytesRead = 0;
+    BOOL writeFailed = NO;
+    while (offset < fileSize && weakOperation.isCancelled == NO) {
+        size_t chunkSize = (size_t)MIN((uint64_t)MIN(chunkSizer.chunkSize, bufferSize), fileSize - offset);
+        CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+        bytesRead = smb_fread(connection.session, fileID, buffer, chunkSize);
+        if (bytesRead <= 0)
+            break;
+        
+        [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                           requestedBytes:chunkSize
+                                 duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                endOfFile:(offset + bytesRead >= fileSize)];
+        
+        if (pwrite(fileDescriptor, buffer, bytesRead, (off_t)offset) != bytesRead) {
+            writeFailed = YES;
+            break;
+        }
+        
+        offset += bytesRead;
+        
+        [self.itemCondition lock];
+        item.bytesTransferred = offset;
+        self.countOfBytesTransferred += bytesRead;
+        [self.itemCondition unlock];
+        
+        [self didUpdateProgress];
+    }
+    
+    //Match the modification date of the file on the device, as download tasks do
+    NSTimeInterval modificationTime = [TOSMBDateFromFileTime(modificationTimestamp) timeIntervalSince1970];
+    struct timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = (time_t)modificationTime;
+    times[0].tv_usec = times[1].tv_usec = (suseconds_t)((modificationTime - floor(modificationTime)) * 1000000.0);
+    futimes(fileDescriptor, times);
+    close(fileDescriptor);
+    
+    if (bytesRead < 0)
+        connection.invalid = YES;
+    else
+        smb_fclose(connection.session, fileID);
+    
+    //Don't leave partial files behind, including ones where the device stopped sending data early
+    if (weakOperation.isCancelled || writeFailed || bytesRead < 0 || offset < fileSize) {
+        unlink(temporaryPath.fileSystemRepresentation);
+        return weakOperation.isCancelled ? nil : errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed);
+    }
+    
+    //Pick the final name and claim it in one go, so two files can't be given the same one
+    [self.itemCondition lock];
+    NSString *finalPath = [self availableFilePathForPath:item.destinationPath];
+    BOOL moved = (rename(temporaryPath.fileSystemRepresentation, finalPath.fileSystemRepresentation) == 0);
+    [self.itemCondition unlock];
+    
+    if (moved == NO) {
+        unlink(temporaryPath.fileSystemRepresentation);
+        return errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed);
+    }
+    
+    item.destinationPath = finalPath;
+    return nil;
+}
+
+- (NSString *)availableFilePathForPath:(NSString *)path
+{
+    //If a file with that name already exists, append a number on the end of the file name, as download tasks do
+    NSString *folderPath = [path stringByDeletingLastPathComponent];
+    NSString *fileName = [path lastPathComponent];
+    NSString *baseName = [fileName stringByDeletingPathExtension];
+    NSString *extension = [fileName pathExtension];
+    
+    NSString *newFilePath = path;
+    NSInteger index = 1;
+    while ([[NSFileManager defaultManager] fileExistsAtPath:newFilePath]) {
+        NSString *newFileName = [NSString stringWithFormat:@"%@-%ld", baseName, (long)index++];
+        if (extension.length > 0)
+            newFileName = [newFileName stringByAppendingPathExtension:extension];
+        newFilePath = [folderPath stringByAppendingPathComponent:newFileName];
+    }
+    
+    return newFilePath;
+}
+
+@end
@@ -0,0 +1,56 @@
+//
+// TOSMBSessionBatchDownloadTaskPrivate.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBSessionBatchDownloadTaskPrivate_h
+#define TOSMBSessionBatchDownloadTaskPrivate_h
+
+#import "TOSMBSessionBatchDownloadTask.h"
+#import "TOSMBSessionBatchTaskPrivate.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface TOSMBSessionBatchDownloadTask ()
+
+/** Feedback handlers */
+@property (nonatomic, weak, nullable) id<TOSMBSessionBatchDownloadTaskDelegate> delegate;
+
+- (instancetype)initWithSession:(TOSMBSession *)session
+                      filePaths:(NSArray<NSString *> *)filePaths
+                destinationPath:(NSString *)destinationPath
+                       delegate:(nullable id<TOSMBSessionBatchDownloadTaskDelegate>)delegate;
+
+- (instancetype)initWithSession:(TOSMBSession *)session
+                      filePaths:(NSArray<NSString *> *)filePaths
+                destinationPath:(NSString *)destinationPath
+                progressHandler:(nullable id)progressHandler
+                 successHandler:(nullable id)successHandler
+                    failHandler:(nullable id)failHandler;
+
+/* For subclasses that discover their files while the batch is already downloading, by overriding
+   `produceItemsWithOperation:`. A list of paths finishes adding its items straight away. */
+- (instancetype)initWithSession:(TOSMBSession *)session destinationPath:(NSString *)destinationPath;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBSessionBatchDownloadTaskPrivate_h */
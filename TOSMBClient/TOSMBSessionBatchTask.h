@@ -0,0 +1,61 @@
+//
+// TOSMBSessionBatchTask.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionTask.h"
+
+/**
+ The shared base of tasks that transfer many files one after the other over a small number of logged-in
+ connections, rather than setting up a new connection, share and task for every file. Each connection stays
+ attached to the shares it has used, and moves straight on to the next file as soon as the last one is done.
+ 
+ This class isn't used directly; see `TOSMBSessionBatchDownloadTask` and `TOSMBSessionDirectoryUploadTask`.
+ */
+@interface TOSMBSessionBatchTask : TOSMBSessionTask
+
+/** The number of connections transferring files at the same time. */
+@property (nonatomic, assign) NSUInteger maximumConnectionCount;
+
+/** The total number of files in the batch. */
+@property (readonly) NSUInteger countOfFiles;
+
+/** The number of files that have finished transferring. */
+@property (readonly) NSUInteger countOfFilesCompleted;
+
+/** The number of files that couldn't be transferred. */
+@property (readonly) NSUInteger countOfFilesFailed;
+
+/** The error of each file that couldn't be transferred, keyed by its source path. */
+@property (readonly) NSDictionary<NSString *, NSError *> *fileErrors;
+
+/** The average number of files transferred per second while the task has been running. */
+@property (readonly) double filesPerSecond;
+
+/** The average number of bytes transferred per second while the task has been running. */
+@property (readonly) double bytesPerSecond;
+
+/** Called on the session's delegate queue alongside each progress update, once for every file being transferred at the time. */
+@property (nonatomic, copy) void (^fileProgressHandler)(NSString *sourcePath, uint64_t totalBytesTransferred, uint64_t totalBytesExpected);
+
+/** Called on the session's delegate queue as each file finishes, with either its destination path or the error that stopped it. */
+@property (nonatomic, copy) void (^fileCompletionHandler)(NSString *sourcePath, NSString *destinationPath, NSError *error);
+
+@end
@@ -0,0 +1,419 @@
+//
+// TOSMBSessionBatchTask.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionBatchTaskPrivate.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBBufferPool.h"
+
+@implementation TOSMBSessionBatchItem
+@end
+
+// -------------------------------------------------------------------------
+
+@interface TOSMBSessionBatchTask ()
+
+@property (assign, readwrite) NSUInteger countOfFiles;
+@property (assign, readwrite) NSUInteger countOfFilesCompleted;
+@property (assign, readwrite) NSUInteger countOfFilesFailed;
+
+@property (nonatomic, strong, readwrite) NSCondition *itemCondition;
+
+/* Files waiting to be transferred, and those currently being transferred */
+@property (nonatomic, strong) NSMutableArray<TOSMBSessionBatchItem *> *pendingItems;
+@property (nonatomic, strong) NSMutableArray<TOSMBSessionBatchItem *> *activeItems;
+@property (nonatomic, assign) BOOL finishedAddingItems;
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSError *> *mutableFileErrors;
+@property (nonatomic, strong) NSError *taskError;
+
+/* Time spent running, for the throughput metrics */
+@property (nonatomic, assign) NSTimeInterval previousRunDuration;
+@property (nonatomic, assign) CFAbsoluteTime runStartTime;
+
+- (TOSMBSessionBatchItem *)nextItemWithOperation:(__weak NSBlockOperation *)weakOperation;
+- (void)runWorkerWithOperation:(__weak NSBlockOperation *)weakOperation;
+- (void)didFinishItem:(TOSMBSessionBatchItem *)item error:(NSError *)error;
+- (void)didSucceed;
+
+@end
+
+@implementation TOSMBSessionBatchTask
+
+- (instancetype)initWithSession:(TOSMBSession *)session
+{
+    if ((self = [super initWithSession:session])) {
+        _maximumConnectionCount = 1;
+        _itemCondition = [[NSCondition alloc] init];
+        _pendingItems = [NSMutableArray array];
+        _activeItems = [NSMutableArray array];
+        _mutableFileErrors = [NSMutableDictionary dictionary];
+    }
+    
+    return self;
+}
+
+#pragma mark - Items -
+
+- (void)addItems:(NSArray<TOSMBSessionBatchItem *> *)items
+{
+    if (items.count == 0)
+        return;
+    
+    [self.itemCondition lock];
+    
+    for (TOSMBSessionBatchItem *item in items) {
+        if (item.expectedSize >= 0)
+            self.countOfBytesExpectedToTransfer += item.expectedSize;
+    }
+    self.countOfFiles += items.count;
+    
+    if (self.prioritizesSmallFiles) {
+        //Keep the waiting files sorted by size, with files of unknown size at the end
+        NSComparator comparator = ^NSComparisonResult(TOSMBSessionBatchItem *first, TOSMBSessionBatchItem *second) {
+            uint64_t firstSize = (uint64_t)first.expectedSize;   //-1 becomes the largest possible size
+            uint64_t secondSize = (uint64_t)second.expectedSize;
+            if (firstSize == secondSize)
+                return NSOrderedSame;
+            return (firstSize < secondSize) ? NSOrderedAscending : NSOrderedDescending;
+        };
+        
+        for (TOSMBSessionBatchItem *item in items) {
+            NSUInteger index = [self.pendingItems indexOfObject:item
+                                                  inSortedRange:NSMakeRange(0, self.pendingItems.count)
+                                                        options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                                                usingComparator:comparator];
+            [self.pendingItems insertObject:item atIndex:index];
+        }
+    }
+    else {
+        [self.pendingItems addObjectsFromArray:items];
+    }
+    
+    [self.itemCondition broadcast];
+    [self.itemCondition unlock];
+}
+
+- (void)finishAddingItems
+{
+    [self.itemCondition lock];
+    self.finishedAddingItems = YES;
+    [self.itemCondition broadcast];
+    [self.itemCondition unlock];
+}
+
+- (TOSMBSessionBatchItem *)nextItemWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    TOSMBSessionBatchItem *item = nil;
+    
+    [self.itemCondition lock];
+    while (weakOperation.isCancelled == NO) {
+        item = self.pendingItems.firstObject;
+        if (item) {
+            [self.pendingItems removeObjectAtIndex:0];
+            [self.activeItems addObject:item];
+            break;
+        }
+        
+        if (self.finishedAddingItems)
+            break;
+        
+        //Wake up now and then to check whether the task was cancelled
+        [self.itemCondition waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    }
+    [self.itemCondition unlock];
+    
+    return item;
+}
+
+- (void)recordTaskError:(NSError *)error
+{
+    if (error == nil)
+        return;
+    
+    [self.itemCondition lock];
+    if (self.taskError == nil)
+        self.taskError = error;
+    [self.itemCondition unlock];
+}
+
+- (void)recordError:(NSError *)error forPath:(NSString *)path
+{
+    [self.itemCondition lock];
+    self.mutableFileErrors[path] = error;
+    [self.itemCondition unlock];
+}
+
+#pragma mark - Subclass Hooks -
+
+- (NSError *)prepareToRunWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    return nil;
+}
+
+- (void)produceItemsWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    return;
+}
+
+- (void)didFinishRunningWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    return;
+}
+
+- (NSError *)transferItem:(TOSMBSessionBatchItem *)item
+               connection:(TOSMBConnection *)connection
+                   buffer:(char *)buffer
+               bufferSize:(size_t)bufferSize
+                operation:(__weak NSBlockOperation *)weakOperation
+{
+    return errorForErrorCode(TOSMBSessionErrorCodeUnknown);
+}
+
+#pragma mark - Progress -
+
+- (uint64_t)progressBytesCompleted
+{
+    return self.countOfBytesTransferred;
+}
+
+- (uint64_t)progressBytesExpected
+{
+    return self.countOfBytesExpectedToTransfer;
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected
+{
+    if (self.progressHandler)
+        self.progressHandler(totalBytes, totalBytesExpected);
+    
+    if (self.fileProgressHandler == nil)
+        return;
+    
+    [self.itemCondition lock];
+    NSArray<TOSMBSessionBatchItem *> *activeItems = [self.activeItems copy];
+    [self.itemCondition unlock];
+    
+    for (TOSMBSessionBatchItem *item in activeItems) {
+        if (item.expectedSize >= 0)
+            self.fileProgressHandler(item.sourcePath, item.bytesTransferred, (uint64_t)item.expectedSize);
+    }
+}
+
+- (NSDictionary<NSString *, NSError *> *)fileErrors
+{
+    [self.itemCondition lock];
+    NSDictionary *fileErrors = [self.mutableFileErrors copy];
+    [self.itemCondition unlock];
+    return fileErrors;
+}
+
+- (NSTimeInterval)runDuration
+{
+    NSTimeInterval duration = self.previousRunDuration;
+    if (self.runStartTime > 0)
+        duration += CFAbsoluteTimeGetCurrent() - self.runStartTime;
+    return duration;
+}
+
+- (double)filesPerSecond
+{
+    NSTimeInterval duration = [self runDuration];
+    return (duration > 0) ? (double)self.countOfFilesCompleted / duration : 0.0;
+}
+
+- (double)bytesPerSecond
+{
+    NSTimeInterval duration = [self runDuration];
+    return (duration > 0) ? (double)self.countOfBytesTransferred / duration : 0.0;
+}
+
+#pragma mark - Feedback Methods -
+
+- (void)didFinishItem:(TOSMBSessionBatchItem *)item error:(NSError *)error
+{
+    [self.itemCondition lock];
+    [self.activeItems removeObject:item];
+    if (error) {
+        self.mutableFileErrors[item.sourcePath] = error;
+        self.countOfFilesFailed++;
+        
+        //A file that stopped partway through won't contribute the rest of its bytes
+        if (item.expectedSize >= 0)
+            self.countOfBytesExpectedToTransfer -= (item.expectedSize - (int64_t)item.bytesTransferred);
+    }
+    else {
+        self.countOfFilesCompleted++;
+    }
+    [self.itemCondition unlock];
+    
+    if (error)
+        [self didUpdateProgress];
+    
+    NSString *sourcePath = item.sourcePath;
+    NSString *destinationPath = error ? nil : item.destinationPath;
+    [self performDelegateBlock:^{
+        [self deliverCompletionOfFileAtPath:sourcePath destinationPath:destinationPath error:error];
+    }];
+}
+
+- (void)deliverCompletionOfFileAtPath:(NSString *)sourcePath destinationPath:(NSString *)destinationPath error:(NSError *)error
+{
+    if (self.fileCompletionHandler)
+        self.fileCompletionHandler(sourcePath, destinationPath, error);
+}
+
+- (void)didSucceed
+{
+    [self performDelegateBlock:^{
+        [self deliverSuccess];
+    }];
+}
+
+- (void)deliverSuccess
+{
+    if (self.successHandler)
+        self.successHandler();
+}
+
+#pragma mark - Transferring -
+
+- (void)performTaskWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    if (weakOperation.isCancelled)
+        return;
+    
+    self.taskError = nil;
+    self.runStartTime = CFAbsoluteTimeGetCurrent();
+    
+    //Create a background handle so the batch will continue even if the app is suspended
+    self.backgroundTaskIdentifier = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{ [self suspend]; }];
+    
+    NSError *error = [self prepareToRunWithOperation:weakOperation];
+    if (error) {
+        self.previousRunDuration += CFAbsoluteTimeGetCurrent() - self.runStartTime;
+        self.runStartTime = 0;
+        
+        [self fail];
+        [self didFailWithError:error];
+        self.cleanupBlock(0, 0);
+        return;
+    }
+    
+    //Each worker transfers files one after the other over its own connection. There's no point in starting
+    //more of them than there are files, once every file is known.
+    [self.itemCondition lock];
+    NSUInteger workerCount = MAX(self.maximumConnectionCount, (NSUInteger)1);
+    if (self.finishedAddingItems)
+        workerCount = MIN(workerCount, self.pendingItems.count);
+    [self.itemCondition unlock];
+    
+    //The last worker produces the items instead, so new files are picked up as soon as they're found
+    if (weakOperation.isCancelled == NO) {
+        [self performWithWorkerCount:workerCount + 1 usingBlock:^(NSUInteger worker) {
+            if (worker == workerCount)
+                [self produceItemsWithOperation:weakOperation];
+            else
+                [self runWorkerWithOperation:weakOperation];
+        }];
+    }
+    
+    self.previousRunDuration += CFAbsoluteTimeGetCurrent() - self.runStartTime;
+    self.runStartTime = 0;
+    
+    [self didFinishRunningWithOperation:weakOperation];
+    
+    if (weakOperation.isCancelled || self.state != TOSMBSessionTaskStateRunning) {
+        self.cleanupBlock(0, 0);
+        return;
+    }
+    
+    //If every worker gave up, the files they left behind are still waiting
+    [self.itemCondition lock];
+    BOOL unfinished = (self.pendingItems.count > 0 || self.finishedAddingItems == NO);
+    NSError *taskError = self.taskError;
+    [self.itemCondition unlock];
+    
+    if (unfinished || (taskError && self.countOfFiles == 0)) {
+        [self fail];
+        [self didFailWithError:taskError ?: errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        self.cleanupBlock(0, 0);
+        return;
+    }
+    
+    self.state = TOSMBSessionTaskStateCompleted;
+    [self didSucceed];
+    self.cleanupBlock(0, 0);
+}
+
+- (void)runWorkerWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    TOSMBSession *session = self.session;
+    TOSMBBufferPool *bufferPool = session.bufferPool;
+    char *buffer = [bufferPool dequeueBuffer];
+    if (buffer == NULL) {
+        [self recordTaskError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        return;
+    }
+    
+    TOSMBConnection *connection = nil;
+    while (weakOperation.isCancelled == NO) {
+        //Replace the connection if the last file broke it
+        if (connection.isInvalid) {
+            [session enqueueConnection:connection];
+            connection = nil;
+        }
+        
+        if (connection == nil) {
+            NSError *error = nil;
+            connection = [session dequeueConnectionWithError:&error];
+            if (connection == nil) {
+                [self recordTaskError:error];
+                break;
+            }
+        }
+        
+        TOSMBSessionBatchItem *item = [self nextItemWithOperation:weakOperation];
+        if (item == nil)
+            break;
+        
+        NSError *error = [self transferItem:item connection:connection buffer:buffer bufferSize:bufferPool.bufferSize operation:weakOperation];
+        
+        //Put a file interrupted by suspending or cancelling back in line, so it's started again on resume
+        if (weakOperation.isCancelled) {
+            [self.itemCondition lock];
+            [self.activeItems removeObject:item];
+            self.countOfBytesTransferred -= item.bytesTransferred;
+            item.bytesTransferred = 0;
+            [self.pendingItems insertObject:item atIndex:0];
+            [self.itemCondition unlock];
+            break;
+        }
+        
+        [self didFinishItem:item error:error];
+    }
+    
+    [bufferPool enqueueBuffer:buffer];
+    if (connection)
+        [session enqueueConnection:connection];
+}
+
+@end
@@ -0,0 +1,89 @@
+//
+// TOSMBSessionBatchTaskPrivate.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBSessionBatchTaskPrivate_h
+#define TOSMBSessionBatchTaskPrivate_h
+
+#import "TOSMBSessionBatchTask.h"
+#import "TOSMBSessionTaskPrivate.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/* A single file of a batch */
+@interface TOSMBSessionBatchItem : NSObject
+
+@property (nonatomic, copy) NSString *sourcePath;
+@property (nonatomic, copy) NSString *destinationPath;
+@property (nonatomic, assign) int64_t expectedSize;     /* -1 until the file has been opened, unless it was known up front */
+@property (nonatomic, assign) uint64_t bytesTransferred;
+
+@end
+
+@interface TOSMBSessionBatchTask () <TOSMBSessionConcreteTask>
+
+@property (nonatomic, copy, nullable) void (^successHandler)(void);
+
+/* Guards the items and every counter, and wakes idle workers when items are added */
+@property (nonatomic, readonly) NSCondition *itemCondition;
+
+/* Byte totals across every file. Only change these while holding `itemCondition`. */
+@property (assign) int64_t countOfBytesTransferred;
+@property (assign) int64_t countOfBytesExpectedToTransfer;
+
+/* Items may be added from any thread until `finishAddingItems` is called */
+- (void)addItems:(NSArray<TOSMBSessionBatchItem *> *)items;
+- (void)finishAddingItems;
+
+/* When YES, waiting files are transferred smallest first. Files of unknown size go last. */
+@property (nonatomic, assign) BOOL prioritizesSmallFiles;
+
+/* Called for errors that stop the whole batch, such as being unable to connect to the device at all */
+- (void)recordTaskError:(NSError *)error;
+
+/* Called for errors of a path that isn't one of the items, so it's still reported in `fileErrors` */
+- (void)recordError:(NSError *)error forPath:(NSString *)path;
+
+/* Subclass hooks, all called on the task's own thread apart from `transferItem:`.
+   Preparation happens before any workers start, and stops the task if it returns an error.
+   Production runs alongside the workers, for subclasses that discover their files as the batch goes.
+   Once the workers have all stopped, `didFinishRunningWithOperation:` is called, whatever the outcome. */
+- (nullable NSError *)prepareToRunWithOperation:(__weak NSBlockOperation *)weakOperation;
+- (void)produceItemsWithOperation:(__weak NSBlockOperation *)weakOperation;
+- (void)didFinishRunningWithOperation:(__weak NSBlockOperation *)weakOperation;
+
+/* Transfers a single file over the worker's connection, returning the error that stopped it, if any.
+   Called from several worker threads at once. Must be overridden. */
+- (nullable NSError *)transferItem:(TOSMBSessionBatchItem *)item
+                        connection:(TOSMBConnection *)connection
+                            buffer:(char *)buffer
+                        bufferSize:(size_t)bufferSize
+                         operation:(__weak NSBlockOperation *)weakOperation;
+
+/* Called on the delegate queue, for subclasses to inform their delegates before calling super */
+- (void)deliverCompletionOfFileAtPath:(NSString *)sourcePath destinationPath:(nullable NSString *)destinationPath error:(nullable NSError *)error;
+- (void)deliverSuccess;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif /* TOSMBSessionBatchTaskPrivate_h */
@@ -0,0 +1,47 @@
+//
+// TOSMBSessionDirectoryDownloadTask.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionBatchDownloadTask.h"
+
+/**
+ Downloads a directory from an SMB device, along with everything inside it, recreating the same hierarchy
+ of folders locally.
+ 
+ The remote tree is listed by a `TOSMBSessionTreeWalker` while files are already being downloaded, and files
+ are downloaded over a bounded number of connections at once. Per-file progress, completions and errors, as
+ well as the aggregate totals, are reported in the same way as any other batch download task.
+ */
+@interface TOSMBSessionDirectoryDownloadTask : TOSMBSessionBatchDownloadTask
+
+/** The path of the directory on the SMB device being downloaded. */
+@property (readonly) NSString *sourceDirectoryPath;
+
+/** When YES, the smallest of the files found so far are downloaded first, so visible progress is made quickly. Default: YES. */
+@property (nonatomic, assign) BOOL prioritizesSmallFiles;
+
+/** The number of directories found inside the source directory so far. */
+@property (readonly) NSUInteger countOfDirectories;
+
+/** Whether the whole tree has been listed, and `countOfFiles` and `countOfBytesExpectedToReceive` are final. */
+@property (readonly, getter=isListingComplete) BOOL listingComplete;
+
+@end
@@ -0,0 +1,163 @@
+//
+// TOSMBSessionDirectoryDownloadTask.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionDirectoryDownloadTaskPrivate.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBSessionTreeWalker.h"
+#import "TOSMBSessionFile.h"
+
+@interface TOSMBSessionDirectoryDownloadTask ()
+
+@property (nonatomic, copy, readwrite) NSString *sourceDirectoryPath;
+@property (assign, readwrite) NSUInteger countOfDirectories;
+@property (assign, readwrite, getter=isListingComplete) BOOL listingComplete;
+
+/* The local directory the contents of the source directory are recreated in */
+@property (nonatomic, copy) NSString *localDirectoryPath;
+
+/* Every file already handed to the batch and every directory already created, so listing the tree again
+   after a resume doesn't add or count them twice */
+@property (nonatomic, strong) NSMutableSet<NSString *> *queuedFilePaths;
+
+- (NSString *)relativePathForFile:(TOSMBSessionFile *)file;
+
+@end
+
+@implementation TOSMBSessionDirectoryDownloadTask
+
+@dynamic prioritizesSmallFiles;
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath
+{
+    //Recreate the directory itself inside the destination, rather than just its contents
+    NSString *localDirectoryPath = [destinationPath stringByAppendingPathComponent:directoryPath.lastPathComponent];
+    
+    if ((self = [super initWithSession:session destinationPath:destinationPath])) {
+        _sourceDirectoryPath = [directoryPath copy];
+        _localDirectoryPath = [localDirectoryPath copy];
+        _queuedFilePaths = [NSMutableSet set];
+        self.maximumConnectionCount = 4;
+        self.prioritizesSmallFiles = YES;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionBatchDownloadTaskDelegate>)delegate
+{
+    if ((self = [self initWithSession:session directoryPath:directoryPath destinationPath:destinationPath])) {
+        self.delegate = delegate;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath progressHandler:(id)progressHandler successHandler:(id)successHandler failHandler:(id)failHandler
+{
+    if ((self = [self initWithSession:session directoryPath:directoryPath destinationPath:destinationPath])) {
+        self.progressHandler = progressHandler;
+        self.successHandler = successHandler;
+        self.failHandler = failHandler;
+    }
+    
+    return self;
+}
+
+#pragma mark - Listing -
+
+- (NSString *)relativePathForFile:(TOSMBSessionFile *)file
+{
+    NSString *rootPath = self.sourceDirectoryPath;
+    while (rootPath.length > 1 && [rootPath hasSuffix:@"/"])
+        rootPath = [rootPath substringToIndex:rootPath.length - 1];
+    
+    NSString *filePath = file.filePath;
+    if ([filePath hasPrefix:rootPath] && filePath.length > rootPath.length + 1)
+        return [filePath substringFromIndex:rootPath.length + 1];
+    
+    return file.name;
+}
+
+- (void)produceItemsWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    if (self.listingComplete)
+        return;
+    
+    [[NSFileManager defaultManager] createDirectoryAtPath:self.localDirectoryPath withIntermediateDirectories:YES attributes:nil error:nil];
+    
+    //List the tree over its own connections, feeding files to the download workers as each directory comes in
+    TOSMBSessionTreeWalker *walker = [self.session treeWalkerForDirectoryAtPath:self.sourceDirectoryPath];
+    walker.maximumConnectionCount = MAX(self.maximumConnectionCount, (NSUInteger)1);
+    
+    __weak typeof(self) weakSelf = self;
+    walker.filesHandler = ^(NSArray<TOSMBSessionFile *> *files) {
+        TOSMBSessionDirectoryDownloadTask *strongSelf = weakSelf;
+        NSMutableArray<TOSMBSessionBatchItem *> *items = [NSMutableArray arrayWithCapacity:files.count];
+        
+        for (TOSMBSessionFile *file in files) {
+            if ([strongSelf.queuedFilePaths containsObject:file.filePath])
+                continue;
+            [strongSelf.queuedFilePaths addObject:file.filePath];
+            
+            NSString *localPath = [strongSelf.localDirectoryPath stringByAppendingPathComponent:[strongSelf relativePathForFile:file]];
+            
+            //Directories are created as they're found, so empty ones are recreated too
+            if (file.directory) {
+                [[NSFileManager defaultManager] createDirectoryAtPath:localPath withIntermediateDirectories:YES attributes:nil error:nil];
+                strongSelf.countOfDirectories++;
+                continue;
+            }
+            
+            TOSMBSessionBatchItem *item = [[TOSMBSessionBatchItem alloc] init];
+            item.sourcePath = file.filePath;
+            item.destinationPath = localPath;
+            item.expectedSize = (int64_t)file.fileSize;
+            [items addObject:item];
+        }
+        
+        [strongSelf addItems:items];
+    };
+    
+    dispatch_semaphore_t walkFinished = dispatch_semaphore_create(0);
+    __block NSError *walkError = nil;
+    walker.completionHandler = ^(NSError *error) {
+        walkError = error;
+        dispatch_semaphore_signal(walkFinished);
+    };
+    [walker start];
+    
+    //Stop listing as soon as the task is suspended or cancelled
+    while (dispatch_semaphore_wait(walkFinished, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.25 * NSEC_PER_SEC))) != 0) {
+        if (weakOperation.isCancelled)
+            [walker cancel];
+    }
+    
+    //An interrupted listing is started again on resume, skipping the files that were already found
+    if (weakOperation.isCancelled || walker.isCancelled)
+        return;
+    
+    [self recordTaskError:walkError];
+    self.listingComplete = YES;
+    [self finishAddingItems];
+}
+
+@end
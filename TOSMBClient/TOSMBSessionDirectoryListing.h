@@ -0,0 +1,81 @@
+//
+// TOSMBSessionDirectoryListing.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+@class TOSMBSession;
+@class TOSMBSessionFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A compact representation of the contents of a directory.
+ 
+ Instead of a `TOSMBSessionFile` object per entry, the names, sizes, flags and raw
+ FILETIME stamps of every entry are stored in contiguous arrays. `TOSMBSessionFile` objects
+ (and their dates) are only created when an entry is accessed, which makes listings of very large
+ directories considerably cheaper in both CPU time and memory.
+ 
+ Entries are sorted by name, in the same order as the `TOSMBSessionFile` listings (`-[NSString compare:]`).
+ */
+@interface TOSMBSessionDirectoryListing : NSObject
+
+/** The session this listing was requested from. */
+@property (nonatomic, readonly, weak) TOSMBSession *session;
+
+/** The file path of the directory this listing describes. */
+@property (nonatomic, readonly) NSString *directoryPath;
+
+/** The number of entries in this listing. */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The name of the entry at the given index. */
+- (NSString *)nameAtIndex:(NSUInteger)index;
+
+/** The size in bytes of the entry at the given index. */
+- (uint64_t)fileSizeAtIndex:(NSUInteger)index;
+
+/** The allocation size in bytes of the entry at the given index. */
+- (uint64_t)allocationSizeAtIndex:(NSUInteger)index;
+
+/** Whether the entry at the given index is a directory. */
+- (BOOL)isDirectoryAtIndex:(NSUInteger)index;
+
+/** The raw FILETIME value (100-nanosecond intervals since 1601) of the last modification of the entry at the given index. */
+- (uint64_t)modificationTimestampAtIndex:(NSUInteger)index;
+
+/**
+ Creates a file object for the entry at the given index.
+ A new object is created on each call, so hold onto it if it's needed more than once.
+ */
+- (TOSMBSessionFile *)fileAtIndex:(NSUInteger)index;
+- (TOSMBSessionFile *)objectAtIndexedSubscript:(NSUInteger)index;
+
+/** Creates file objects for each entry in turn. Set `stop` to YES to end the enumeration early. */
+- (void)enumerateFilesUsingBlock:(void (^)(TOSMBSessionFile *file, NSUInteger index, BOOL *stop))block;
+
+/** Creates file objects for every entry in this listing. */
+- (NSArray<TOSMBSessionFile *> *)allFiles;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,327 @@
+//
+// TOSMBSessionDirectoryListing.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <stdlib.h>
+
+#import "TOSMBSessionDirectoryListing.h"
+#import "TOSMBSessionDirectoryListingPrivate.h"
+#import "TOSMBSessionFile.h"
+#import "TOSMBSessionFilePrivate.h"
+
+/* Bit flags stored per entry */
+typedef NS_OPTIONS(uint8_t, TOSMBListingEntryFlags) {
+    TOSMBListingEntryFlagDirectory = 1 << 0,
+    TOSMBListingEntryFlagShare     = 1 << 1
+};
+
+@interface TOSMBSessionDirectoryListing () {
+    /* Every name, each terminated with a NUL, packed back to back */
+    char *_names;
+    size_t _namesLength;
+    size_t _namesCapacity;
+    
+    /* One value per entry, in the order they were appended */
+    uint32_t *_nameOffsets;
+    uint64_t *_fileSizes;
+    uint64_t *_allocationSizes;
+    uint64_t *_creationTimestamps;
+    uint64_t *_accessTimestamps;
+    uint64_t *_writeTimestamps;
+    uint64_t *_modificationTimestamps;
+    uint8_t *_flags;
+    NSUInteger _capacity;
+    
+    /* The entry index for each position once sorted (NULL until sorted) */
+    uint32_t *_sortedIndexes;
+}
+
+@property (nonatomic, weak, readwrite) TOSMBSession *session;
+@property (nonatomic, copy, readwrite) NSString *directoryPath;
+@property (nonatomic, assign, readwrite) NSUInteger count;
+
+- (BOOL)ensureCapacityForEntryWithNameLength:(size_t)nameLength;
+- (void)freeEntries;
+- (NSUInteger)entryIndexForIndex:(NSUInteger)index;
+
+@end
+
+@implementation TOSMBSessionDirectoryListing
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)path
+{
+    if (self = [super init]) {
+        _session = session;
+        _directoryPath = [path copy];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [self freeEntries];
+}
+
+- (void)freeEntries
+{
+    free(_names);
+    free(_nameOffsets);
+    free(_fileSizes);
+    free(_allocationSizes);
+    free(_creationTimestamps);
+    free(_accessTimestamps);
+    free(_writeTimestamps);
+    free(_modificationTimestamps);
+    free(_flags);
+    free(_sortedIndexes);
+    
+    _names = NULL;
+    _nameOffsets = NULL;
+    _fileSizes = NULL;
+    _allocationSizes = NULL;
+    _creationTimestamps = NULL;
+    _accessTimestamps = NULL;
+    _writeTimestamps = NULL;
+    _modificationTimestamps = NULL;
+    _flags = NULL;
+    _sortedIndexes = NULL;
+    _namesLength = _namesCapacity = _capacity = 0;
+    _count = 0;
+}
+
+#pragma mark - Building -
+- (BOOL)ensureCapacityForEntryWithNameLength:(size_t)nameLength
+{
+    if (_namesLength + nameLength + 1 > _namesCapacity) {
+        _namesCapacity = MAX(_namesCapacity * 2, _namesLength + nameLength + 1);
+        _names = reallocf(_names, _namesCapacity);
+    }
+    
+    if (self.count >= _capacity) {
+        _capacity = MAX(_capacity * 2, 64);
+        _nameOffsets = reallocf(_nameOffsets, _capacity * sizeof(uint32_t));
+        _fileSizes = reallocf(_fileSizes, _capacity * sizeof(uint64_t));
+        _allocationSizes = reallocf(_allocationSizes, _capacity * sizeof(uint64_t));
+        _creationTimestamps = reallocf(_creationTimestamps, _capacity * sizeof(uint64_t));
+        _accessTimestamps = reallocf(_accessTimestamps, _capacity * sizeof(uint64_t));
+        _writeTimestamps = reallocf(_writeTimestamps, _capacity * sizeof(uint64_t));
+        _modificationTimestamps = reallocf(_modificationTimestamps, _capacity * sizeof(uint64_t));
+        _flags = reallocf(_flags, _capacity * sizeof(uint8_t));
+    }
+    
+    //reallocf() frees the old block when it fails, so there's nothing left worth keeping
+    if (_names && _nameOffsets && _fileSizes && _allocationSizes && _creationTimestamps &&
+        _accessTimestamps && _writeTimestamps && _modificationTimestamps && _flags)
+        return YES;
+    
+    [self freeEntries];
+    return NO;
+}
+
+- (BOOL)appendStat:(smb_stat)stat
+{
+    const char *name = smb_stat_name(stat);
+    if (name == NULL)
+        return YES;
+    
+    size_t nameLength = strlen(name);
+    if ([self ensureCapacityForEntryWithNameLength:nameLength] == NO)
+        return NO;
+    
+    NSUInteger entry = self.count;
+    _nameOffsets[entry] = (uint32_t)_namesLength;
+    memcpy(_names + _namesLength, name, nameLength + 1);
+    _namesLength += nameLength + 1;
+    
+    _fileSizes[entry] = smb_stat_get(stat, SMB_STAT_SIZE);
+    _allocationSizes[entry] = smb_stat_get(stat, SMB_STAT_ALLOC_SIZE);
+    _creationTimestamps[entry] = smb_stat_get(stat, SMB_STAT_CTIME);
+    _accessTimestamps[entry] = smb_stat_get(stat, SMB_STAT_ATIME);
+    _writeTimestamps[entry] = smb_stat_get(stat, SMB_STAT_WTIME);
+    _modificationTimestamps[entry] = smb_stat_get(stat, SMB_STAT_MTIME);
+    _flags[entry] = (smb_stat_get(stat, SMB_STAT_ISDIR) != 0) ? TOSMBListingEntryFlagDirectory : 0;
+    
+    self.count++;
+    return YES;
+}
+
+- (BOOL)appendShareName:(const char *)shareName
+{
+    if (shareName == NULL)
+        return YES;
+    
+    size_t nameLength = strlen(shareName);
+    if ([self ensureCapacityForEntryWithNameLength:nameLength] == NO)
+        return NO;
+    
+    NSUInteger entry = self.count;
+    _nameOffsets[entry] = (uint32_t)_namesLength;
+    memcpy(_names + _namesLength, shareName, nameLength + 1);
+    _namesLength += nameLength + 1;
+    
+    _fileSizes[entry] = 0;
+    _allocationSizes[entry] = 0;
+    _creationTimestamps[entry] = 0;
+    _accessTimestamps[entry] = 0;
+    _writeTimestamps[entry] = 0;
+    _modificationTimestamps[entry] = 0;
+    _flags[entry] = TOSMBListingEntryFlagDirectory | TOSMBListingEntryFlagShare;
+    
+    self.count++;
+    return YES;
+}
+
+- (void)sortByName
+{
+    NSUInteger count = self.count;
+    if (count < 2)
+        return;
+    
+    free(_sortedIndexes);
+    _sortedIndexes = malloc(count * sizeof(uint32_t));
+    if (_sortedIndexes == NULL)
+        return;
+    
+    for (uint32_t i = 0; i < count; i++)
+        _sortedIndexes[i] = i;
+    
+    //Names are ordered the same way as the object listings, which sort with -compare:. For plain ASCII names that's
+    //the same as comparing the packed bytes, so strings are only created for the names that aren't.
+    const char *names = _names;
+    const uint32_t *nameOffsets = _nameOffsets;
+    NSMutableArray *nameStrings = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        const char *name = names + nameOffsets[i];
+        BOOL isASCII = YES;
+        for (const char *c = name; *c && isASCII; c++)
+            isASCII = ((unsigned char)*c < 0x80);
+        
+        [nameStrings addObject:isASCII ? (id)[NSNull null] : ([NSString stringWithUTF8String:name] ?: @"")];
+    }
+    
+    qsort_b(_sortedIndexes, count, sizeof(uint32_t), ^int(const void *a, const void *b) {
+        uint32_t first = *(const uint32_t *)a;
+        uint32_t second = *(const uint32_t *)b;
+        id firstString = nameStrings[first];
+        id secondString = nameStrings[second];
+        if (firstString == [NSNull null] && secondString == [NSNull null])
+            return strcmp(names + nameOffsets[first], names + nameOffsets[second]);
+        
+        if (firstString == [NSNull null])
+            firstString = [NSString stringWithUTF8String:names + nameOffsets[first]];
+        if (secondString == [NSNull null])
+            secondString = [NSString stringWithUTF8String:names + nameOffsets[second]];
+        
+        return (int)[(NSString *)firstString compare:secondString];
+    });
+}
+
+#pragma mark - Accessing Entries -
+- (NSUInteger)entryIndexForIndex:(NSUInteger)index
+{
+    if (index >= self.count) {
+        [NSException raise:NSRangeException format:@"Index %lu is beyond bounds of listing with %lu entries", (unsigned long)index, (unsigned long)self.count];
+    }
+    
+    return _sortedIndexes ? _sortedIndexes[index] : index;
+}
+
+- (NSString *)nameAtIndex:(NSUInteger)index
+{
+    NSUInteger entry = [self entryIndexForIndex:index];
+    return [NSString stringWithUTF8String:_names + _nameOffsets[entry]] ?: @"";
+}
+
+- (uint64_t)fileSizeAtIndex:(NSUInteger)index
+{
+    return _fileSizes[[self entryIndexForIndex:index]];
+}
+
+- (uint64_t)allocationSizeAtIndex:(NSUInteger)index
+{
+    return _allocationSizes[[self entryIndexForIndex:index]];
+}
+
+- (BOOL)isDirectoryAtIndex:(NSUInteger)index
+{
+    return (_flags[[self entryIndexForIndex:index]] & TOSMBListingEntryFlagDirectory) != 0;
+}
+
+- (uint64_t)modificationTimestampAtIndex:(NSUInteger)index
+{
+    return _modificationTimestamps[[self entryIndexForIndex:index]];
+}
+
+- (TOSMBSessionFile *)fileAtIndex:(NSUInteger)index
+{
+    NSUInteger entry = [self entryIndexForIndex:index];
+    NSString *name = [self nameAtIndex:index];
+    
+    if (_flags[entry] & TOSMBListingEntryFlagShare)
+        return [[TOSMBSessionFile alloc] initWithShareName:name session:self.session];
+    
+    return [[TOSMBSessionFile alloc] initWithName:name
+                                         fileSize:_fileSizes[entry]
+                                   allocationSize:_allocationSizes[entry]
+                                        directory:(_flags[entry] & TOSMBListingEntryFlagDirectory) != 0
+                                creationTimestamp:_creationTimestamps[entry]
+                                  accessTimestamp:_accessTimestamps[entry]
+                                   writeTimestamp:_writeTimestamps[entry]
+                            modificationTimestamp:_modificationTimestamps[entry]
+                                          session:self.session
+                          parentDirectoryFilePath:self.directoryPath];
+}
+
+- (TOSMBSessionFile *)objectAtIndexedSubscript:(NSUInteger)index
+{
+    return [self fileAtIndex:index];
+}
+
+- (void)enumerateFilesUsingBlock:(void (^)(TOSMBSessionFile *, NSUInteger, BOOL *))block
+{
+    if (block == nil)
+        return;
+    
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < self.count && stop == NO; i++) {
+        @autoreleasepool {
+            block([self fileAtIndex:i], i, &stop);
+        }
+    }
+}
+
+- (NSArray<TOSMBSessionFile *> *)allFiles
+{
+    NSMutableArray *files = [NSMutableArray arrayWithCapacity:self.count];
+    for (NSUInteger i = 0; i < self.count; i++)
+        [files addObject:[self fileAtIndex:i]];
+    
+    return [NSArray arrayWithArray:files];
+}
+
+#pragma mark - Debug -
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@ - Path: %@ | Entries: %lu", [super description], self.directoryPath, (unsigned long)self.count];
+}
+
+@end
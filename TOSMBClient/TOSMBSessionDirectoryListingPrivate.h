@@ -0,0 +1,51 @@
+//
+// TOSMBSessionDirectoryListingPrivate.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBSessionDirectoryListingPrivate_h
+#define TOSMBSessionDirectoryListingPrivate_h
+
+#import "TOSMBSessionDirectoryListing.h"
+#import "smb_stat.h"
+
+@interface TOSMBSessionDirectoryListing ()
+
+/**
+ * Init a new, empty listing for a directory
+ *
+ * @param session The session in which this directory belongs to
+ * @param path The absolute file path of the directory
+ */
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)path;
+
+/** Copies the values out of a stat entry into the end of this listing.
+    Returns NO, leaving the listing empty, if there wasn't enough memory to grow it. */
+- (BOOL)appendStat:(smb_stat)stat;
+
+/** Appends a share entry (Used when listing the root of the device). Returns NO if it ran out of memory. */
+- (BOOL)appendShareName:(const char *)shareName;
+
+/** Sorts the entries by name. Called once all entries have been appended. */
+- (void)sortByName;
+
+@end
+
+#endif /* TOSMBSessionDirectoryListingPrivate_h */
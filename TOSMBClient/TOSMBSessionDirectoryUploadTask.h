@@ -0,0 +1,101 @@
+//
+// TOSMBSessionDirectoryUploadTask.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionBatchTask.h"
+
+@class TOSMBSessionDirectoryUploadTask;
+
+@protocol TOSMBSessionDirectoryUploadTaskDelegate <TOSMBSessionTaskDelegate>
+@optional
+
+/**
+ Delegate event that is called as each file finishes uploading.
+ 
+ @param task The directory upload task object calling this delegate method.
+ @param sourcePath The local path of the file.
+ @param destinationPath The path the file was uploaded to on the SMB device.
+ */
+- (void)directoryUploadTask:(TOSMBSessionDirectoryUploadTask *)task
+didFinishUploadingFileAtPath:(NSString *)sourcePath
+                     toPath:(NSString *)destinationPath;
+
+/**
+ Delegate event that is called when a single file couldn't be uploaded. The rest of the directory carries on.
+ 
+ @param task The directory upload task object calling this delegate method.
+ @param sourcePath The local path of the file.
+ @param error The error describing why the file couldn't be uploaded.
+ */
+- (void)directoryUploadTask:(TOSMBSessionDirectoryUploadTask *)task
+  didFailToUploadFileAtPath:(NSString *)sourcePath
+                      error:(NSError *)error;
+
+/**
+ Delegate event that is called periodically as the upload progresses, with the totals across all of its files.
+ 
+ @param task The directory upload task object calling this delegate method.
+ @param bytesSent The number of bytes sent since the last update
+ @param totalBytesSent The total number of bytes sent so far
+ @param totalBytesExpectedToSend The total size of every file in the directory
+ */
+- (void)directoryUploadTask:(TOSMBSessionDirectoryUploadTask *)task
+               didSendBytes:(uint64_t)bytesSent
+             totalBytesSent:(uint64_t)totalBytesSent
+   totalBytesExpectedToSend:(uint64_t)totalBytesExpectedToSend;
+
+/**
+ Delegate event that is called once every file in the directory has either been uploaded, or failed.
+ 
+ @param task The directory upload task object calling this delegate method.
+ */
+- (void)directoryUploadTaskDidFinishUploading:(TOSMBSessionDirectoryUploadTask *)task;
+
+@end
+
+/**
+ Uploads a local directory to an SMB device, along with everything inside it, recreating the same hierarchy
+ of folders on the device.
+ 
+ Each folder is created once, before any files are sent, and any that already exist are reused. Files are then
+ streamed from disk over a bounded number of connections (4 by default), each of which stays attached to the
+ share and moves straight on to the next file. Each file is written to a hidden temporary file and only renamed
+ into place once it has been sent completely, replacing any file already on the device. Folders that couldn't
+ be created are reported in `fileErrors` alongside the files, keyed by their local paths.
+ */
+@interface TOSMBSessionDirectoryUploadTask : TOSMBSessionBatchTask
+
+/** The local directory being uploaded. */
+@property (readonly) NSString *sourceDirectoryPath;
+
+/** The directory on the SMB device that the directory is uploaded into. */
+@property (readonly) NSString *destinationDirectoryPath;
+
+/** The number of directories inside the source directory. */
+@property (readonly) NSUInteger countOfDirectories;
+
+/** The number of bytes presently uploaded across all of the files. */
+@property (readonly) int64_t countOfBytesSent;
+
+/** The total number of bytes expected across all of the files. */
+@property (readonly) int64_t countOfBytesExpectedToSend;
+
+@end
@@ -0,0 +1,402 @@
+//
+// TOSMBSessionDirectoryUploadTask.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+#import "TOSMBSessionDirectoryUploadTaskPrivate.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBChunkSizer.h"
+
+@interface TOSMBSessionDirectoryUploadTask ()
+
+@property (nonatomic, copy, readwrite) NSString *sourceDirectoryPath;
+@property (nonatomic, copy, readwrite) NSString *destinationDirectoryPath;
+@property (assign, readwrite) NSUInteger countOfDirectories;
+
+/* The directory on the device that the contents of the source directory are recreated in */
+@property (nonatomic, copy) NSString *remoteDirectoryPath;
+
+/* Every directory that needs to exist on the device, parents first, and those that have been created so far */
+@property (nonatomic, strong) NSMutableArray<NSString *> *directoryPaths;
+@property (nonatomic, strong) NSMutableSet<NSString *> *createdDirectoryPaths;
+@property (nonatomic, assign) BOOL listedSourceDirectory;
+
+- (void)listSourceDirectory;
+- (NSError *)createDirectoriesWithOperation:(__weak NSBlockOperation *)weakOperation;
+- (BOOL)moveTemporaryFileAtPath:(const char *)temporaryPath toPath:(NSString *)path connection:(TOSMBConnection *)connection treeID:(smb_tid)treeID;
+- (NSString *)formattedPathForPath:(NSString *)path;
+
+@end
+
+@implementation TOSMBSessionDirectoryUploadTask
+
+@dynamic delegate;
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath
+{
+    if ((self = [super initWithSession:session])) {
+        _sourceDirectoryPath = [directoryPath copy];
+        _destinationDirectoryPath = [destinationPath copy];
+        
+        //Recreate the directory itself inside the destination, rather than just its contents
+        _remoteDirectoryPath = [[destinationPath stringByAppendingPathComponent:directoryPath.lastPathComponent] copy];
+        
+        _directoryPaths = [NSMutableArray array];
+        _createdDirectoryPaths = [NSMutableSet set];
+        self.maximumConnectionCount = 4;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath delegate:(id<TOSMBSessionDirectoryUploadTaskDelegate>)delegate
+{
+    if ((self = [self initWithSession:session directoryPath:directoryPath destinationPath:destinationPath])) {
+        self.delegate = delegate;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session directoryPath:(NSString *)directoryPath destinationPath:(NSString *)destinationPath progressHandler:(id)progressHandler successHandler:(id)successHandler failHandler:(id)failHandler
+{
+    if ((self = [self initWithSession:session directoryPath:directoryPath destinationPath:destinationPath])) {
+        self.progressHandler = progressHandler;
+        self.successHandler = successHandler;
+        self.failHandler = failHandler;
+    }
+    
+    return self;
+}
+
+#pragma mark - Directories -
+
+- (void)listSourceDirectory
+{
+    [self.directoryPaths addObject:self.remoteDirectoryPath];
+    
+    NSURL *directoryURL = [NSURL fileURLWithPath:self.sourceDirectoryPath isDirectory:YES];
+    NSArray *keys = @[NSURLIsDirectoryKey, NSURLFileSizeKey];
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
+                                                             includingPropertiesForKeys:keys
+                                                                                options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                           errorHandler:nil];
+    
+    //The enumerator visits every directory before its contents, so parents are always created before their children
+    NSString *basePath = directoryURL.URLByStandardizingPath.path;
+    NSMutableArray *items = [NSMutableArray array];
+    for (NSURL *url in enumerator) {
+        NSString *path = url.URLByStandardizingPath.path;
+        if ([path hasPrefix:basePath] == NO)
+            continue;
+        
+        NSString *relativePath = [path substringFromIndex:basePath.length];
+        NSString *remotePath = [self.remoteDirectoryPath stringByAppendingPathComponent:relativePath];
+        
+        NSNumber *isDirectory = nil;
+        [url getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:nil];
+        if (isDirectory.boolValue) {
+            [self.directoryPaths addObject:remotePath];
+            continue;
+        }
+        
+        NSNumber *fileSize = nil;
+        [url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+        
+        TOSMBSessionBatchItem *item = [[TOSMBSessionBatchItem alloc] init];
+        item.sourcePath = path;
+        item.destinationPath = remotePath;
+        item.expectedSize = fileSize.longLongValue;
+        [items addObject:item];
+    }
+    
+    self.countOfDirectories = self.directoryPaths.count - 1;
+    [self addItems:items];
+    [self finishAddingItems];
+    
+    self.listedSourceDirectory = YES;
+}
+
+- (NSError *)createDirectoriesWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    //Each directory is only created once, even across resumes
+    for (NSString *directoryPath in self.directoryPaths) {
+        if (weakOperation.isCancelled)
+            break;
+        
+        if ([self.createdDirectoryPaths containsObject:directoryPath])
+            continue;
+        
+        NSError *error = [self.session createDirectoryAtPath:directoryPath connection:self.connection];
+        if (error == nil) {
+            [self.createdDirectoryPaths addObject:directoryPath];
+            continue;
+        }
+        
+        //Without the top directory, nothing can be uploaded at all
+        if ([directoryPath isEqualToString:self.remoteDirectoryPath])
+            return error;
+        
+        //The files inside a missing directory will fail on their own as they're attempted
+        NSString *relativePath = [directoryPath substringFromIndex:self.remoteDirectoryPath.length];
+        [self recordError:error forPath:[self.sourceDirectoryPath stringByAppendingPathComponent:relativePath]];
+    }
+    
+    return nil;
+}
+
+#pragma mark - Progress -
+
+- (int64_t)countOfBytesSent
+{
+    return self.countOfBytesTransferred;
+}
+
+- (int64_t)countOfBytesExpectedToSend
+{
+    return self.countOfBytesExpectedToTransfer;
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected
+{
+    if (self.delegate && [self.delegate respondsToSelector:@selector(directoryUploadTask:didSendBytes:totalBytesSent:totalBytesExpectedToSend:)])
+        [self.delegate directoryUploadTask:self didSendBytes:bytes totalBytesSent:totalBytes totalBytesExpectedToSend:totalBytesExpected];
+    
+    [super deliverProgressWithBytes:bytes totalBytes:totalBytes totalBytesExpected:totalBytesExpected];
+}
+
+#pragma mark - Feedback Methods -
+
+- (void)deliverCompletionOfFileAtPath:(NSString *)sourcePath destinationPath:(NSString *)destinationPath error:(NSError *)error
+{
+    if (error) {
+        if (self.delegate && [self.delegate respondsToSelector:@selector(directoryUploadTask:didFailToUploadFileAtPath:error:)])
+            [self.delegate directoryUploadTask:self didFailToUploadFileAtPath:sourcePath error:error];
+    }
+    else {
+        if (self.delegate && [self.delegate respondsToSelector:@selector(directoryUploadTask:didFinishUploadingFileAtPath:toPath:)])
+            [self.delegate directoryUploadTask:self didFinishUploadingFileAtPath:sourcePath toPath:destinationPath];
+    }
+    
+    [super deliverCompletionOfFileAtPath:sourcePath destinationPath:destinationPath error:error];
+}
+
+- (void)deliverSuccess
+{
+    if (self.delegate && [self.delegate respondsToSelector:@selector(directoryUploadTaskDidFinishUploading:)])
+        [self.delegate directoryUploadTaskDidFinishUploading:self];
+    
+    [super deliverSuccess];
+}
+
+#pragma mark - Uploading -
+
+- (NSError *)prepareToRunWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    if (self.listedSourceDirectory == NO)
+        [self listSourceDirectory];
+    
+    //Create the directories on the device before any of the files are sent
+    NSError *error = nil;
+    self.connection = [self.session dequeueConnectionWithError:&error];
+    if (self.connection == nil)
+        return error;
+    
+    error = [self createDirectoriesWithOperation:weakOperation];
+    
+    //Hand the connection back, so it can be picked up again by one of the workers
+    [self.session enqueueConnection:self.connection];
+    self.connection = nil;
+    
+    return error;
+}
+
+- (void)didFinishRunningWithOperation:(__weak NSBlockOperation *)weakOperation
+{
+    //Make sure the next listing of each folder picks up the new files
+    for (NSString *directoryPath in self.createdDirectoryPaths)
+        [self.session invalidateCachedContentsOfDirectoryAtFilePath:directoryPath];
+}
+
+- (NSError *)transferItem:(TOSMBSessionBatchItem *)item
+               connection:(TOSMBConnection *)connection
+                   buffer:(char *)buffer
+               bufferSize:(size_t)bufferSize
+                operation:(__weak NSBlockOperation *)weakOperation
+{
+    TOSMBSession *session = self.session;
+    
+    //---------------------------------------------------------------------------------------
+    //Open the local file, and take its size as it is now
+    
+    int fileDescriptor = open(item.sourcePath.fileSystemRepresentation, O_RDONLY);
+    if (fileDescriptor < 0)
+        return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+    
+    struct stat localStat;
+    uint64_t fileSize = (fstat(fileDescriptor, &localStat) == 0) ? (uint64_t)localStat.st_size : (uint64_t)item.expectedSize;
+    
+    [self.itemCondition lock];
+    self.countOfBytesExpectedToTransfer += (int64_t)fileSize - item.expectedSize;
+    item.expectedSize = (int64_t)fileSize;
+    [self.itemCondition unlock];
+    
+    //The file is only read once, front to back
+    fcntl(fileDescriptor, F_RDAHEAD, 1);
+    fcntl(fileDescriptor, F_NOCACHE, 1);
+    
+    //---------------------------------------------------------------------------------------
+    //Open a temporary file next to the destination, reusing the tree ID of the share if this connection has used it before.
+    //The file is only moved into place once all of it has been written, so a failed upload never leaves a partial file behind.
+    
+    NSString *shareName = [session shareNameFromPath:item.destinationPath];
+    NSString *temporaryFileName = [NSString stringWithFormat:@".%@.tosmbupload", item.destinationPath.lastPathComponent];
+    NSString *formattedTemporaryPath = [self formattedPathForPath:[[item.destinationPath stringByDeletingLastPathComponent] stringByAppendingPathComponent:temporaryFileName]];
+    const char *fileCString = [formattedTemporaryPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    smb_tid treeID = 0;
+    __block smb_fd fileID = 0;
+    NSError *error = [connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        smb_fopen(connection.session, shareTreeID, fileCString, SMB_MOD_RW, &fileID);
+        return (fileID != 0);
+    }];
+    if (error) {
+        close(fileDescriptor);
+        return error;
+    }
+    
+    //Existing files aren't truncated when opened, so one left over from an earlier attempt that's larger than the new file
+    //has to be deleted first, or its end would outlast the new data. The open response carries its size, so this costs nothing otherwise.
+    smb_stat remoteStat = fileID ? smb_stat_fd(connection.session, fileID) : NULL;
+    if (remoteStat && smb_stat_get(remoteStat, SMB_STAT_SIZE) > fileSize) {
+        smb_fclose(connection.session, fileID);
+        fileID = 0;
+        smb_file_rm(connection.session, treeID, fileCString);
+        smb_fopen(connection.session, treeID, fileCString, SMB_MOD_RW, &fileID);
+    }
+    
+    if (!fileID) {
+        close(fileDescriptor);
+        return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+    }
+    
+    //---------------------------------------------------------------------------------------
+    //Stream the file to the device, one buffer at a time
+    
+    TOSMBChunkSizer *chunkSizer = session.writeChunkSizer;
+    uint64_t offset = 0;
+    ssize_t bytesWritten = 0;
+    BOOL readFailed = NO;
+    while (offset < fileSize && weakOperation.isCancelled == NO) {
+        size_t chunkSize = (size_t)MIN((uint64_t)MIN(chunkSizer.chunkSize, bufferSize), fileSize - offset);
+        ssize_t bytesRead = pread(fileDescriptor, buffer, chunkSize, (off_t)offset);
+        if (bytesRead <= 0) {
+            readFailed = YES;
+            break;
+        }
+        
+        CFAbsoluteTime writeStartTime = CFAbsoluteTimeGetCurrent();
+        bytesWritten = smb_fwrite(connection.session, fileID, buffer, (size_t)bytesRead);
+        if (bytesWritten <= 0)
+            break;
+        
+        [chunkSizer recordTransferOfBytes:(size_t)bytesWritten
+                           requestedBytes:(size_t)bytesRead
+                                 duration:CFAbsoluteTimeGetCurrent() - writeStartTime
+                                endOfFile:(offset + bytesWritten >= fileSize)];
+        
+        offset += bytesWritten;
+        
+        [self.itemCondition lock];
+        item.bytesTransferred = offset;
+        self.countOfBytesTransferred += bytesWritten;
+        [self.itemCondition unlock];
+        
+        [self didUpdateProgress];
+    }
+    
+    close(fileDescriptor);
+    
+    if (bytesWritten < 0)
+        connection.invalid = YES;
+    else
+        smb_fclose(connection.session, fileID);
+    
+    //The connection can't be used to clean up after a network error
+    if (bytesWritten < 0)
+        return weakOperation.isCancelled ? nil : errorForErrorCode(TOSMBSessionErrorCodeFileUploadFailed);
+    
+    if (weakOperation.isCancelled || readFailed || offset < fileSize) {
+        smb_file_rm(connection.session, treeID, fileCString);
+        return weakOperation.isCancelled ? nil : errorForErrorCode(TOSMBSessionErrorCodeFileUploadFailed);
+    }
+    
+    //---------------------------------------------------------------------------------------
+    //Move the finished file into place
+    
+    if ([self moveTemporaryFileAtPath:fileCString toPath:item.destinationPath connection:connection treeID:treeID] == NO) {
+        smb_file_rm(connection.session, treeID, fileCString);
+        return errorForErrorCode(TOSMBSessionErrorCodeFileUploadFailed);
+    }
+    
+    return nil;
+}
+
+- (BOOL)moveTemporaryFileAtPath:(const char *)temporaryPath toPath:(NSString *)path connection:(TOSMBConnection *)connection treeID:(smb_tid)treeID
+{
+    const char *destinationPath = [[self formattedPathForPath:path] cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    //Most files are new, so try the rename straight away
+    if (smb_file_mv(connection.session, treeID, temporaryPath, destinationPath) == 0)
+        return YES;
+    
+    //SMB renames won't replace an existing file, so the older copy is renamed out of the way first,
+    //and only deleted once the new file has taken its place, as upload tasks do
+    NSString *backupFileName = [NSString stringWithFormat:@".%@.tosmbbackup", path.lastPathComponent];
+    NSString *formattedBackupPath = [self formattedPathForPath:[[path stringByDeletingLastPathComponent] stringByAppendingPathComponent:backupFileName]];
+    const char *backupPath = [formattedBackupPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    //A copy left behind by an earlier upload that didn't get to finish would block the rename
+    smb_file_rm(connection.session, treeID, backupPath);
+    if (smb_file_mv(connection.session, treeID, destinationPath, backupPath) != 0)
+        return NO;
+    
+    if (smb_file_mv(connection.session, treeID, temporaryPath, destinationPath) != 0) {
+        //Put the old copy back where it was, rather than leaving nothing at the destination
+        smb_file_mv(connection.session, treeID, backupPath, destinationPath);
+        return NO;
+    }
+    
+    smb_file_rm(connection.session, treeID, backupPath);
+    return YES;
+}
+
+- (NSString *)formattedPathForPath:(NSString *)path
+{
+    NSString *formattedPath = [self.session filePathExcludingSharePathFromPath:path];
+    formattedPath = [NSString stringWithFormat:@"\\%@",formattedPath];
+    return [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+}
+
+@end
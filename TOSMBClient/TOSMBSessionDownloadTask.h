@@ -40,6 +40,14 @@
  */
 - (void)downloadTask:(TOSMBSessionDownloadTask *)downloadTask didFinishDownloadingToPath:(NSString *)destinationPath;
 
+/**
+ Delegate event that is called when a byte range task downloading into memory has completed.
+ 
+ @param downloadTask The download task object calling this delegate method.
+ @param data The data of each requested range, in the same order as the task's `byteRanges`.
+ */
+- (void)downloadTask:(TOSMBSessionDownloadTask *)downloadTask didFinishDownloadingRangeData:(NSArray<NSData *> *)data;
+
 /**
  Delegate event that is called periodically as the download progresses, updating the delegate with the amount of data that has been downloaded.
  
@@ -88,4 +96,33 @@ totalBytesExpectedToReceive:(uint64_t)totalBytesToReceive;
 /** The total number of bytes we expect to download */
 @property (readonly) int64_t countOfBytesExpectedToReceive;
 
+/** For tasks that only download parts of the file, the byte ranges (As NSRange values) being downloaded.
+ Ranges extending past the end of the file are shortened to fit. nil if the whole file is being downloaded. */
+@property (readonly) NSArray<NSValue *> *byteRanges;
+
+/** For byte range tasks downloading into memory, the data of each range once the task has completed. */
+@property (readonly) NSArray<NSData *> *rangeData;
+
+/** The number of connections used to download separate segments of the file in parallel.
+ Files smaller than two segments are always downloaded over a single connection. Default: 1. */
+@property (nonatomic, assign) NSUInteger maximumConnectionCount;
+
+/** The size, in bytes, of each segment when downloading over multiple connections.
+ The progress of each segment is tracked separately, so a resumed download only requests the missing segments. Default: 4 MB. */
+@property (nonatomic, assign) uint64_t segmentSize;
+
+/** The number of buffers that may be filled from the network while earlier ones are still being written to disk.
+ Setting this to 1 waits for each write to finish before reading the next chunk. At most 16 are used. Default: 4. */
+@property (nonatomic, assign) NSUInteger pipelineBufferCount;
+
+/** How often downloaded data is flushed to disk. If the app is terminated between flushes, the download resumes
+ from the last flushed position, rather than from the end of the partial file. Default: TOSMBSessionDownloadDurabilityEveryChunk. */
+@property (nonatomic, assign) TOSMBSessionDownloadDurability durability;
+
+/** With periodic durability, the number of bytes written between each flush. Default: 8 MB. */
+@property (nonatomic, assign) uint64_t synchronizationByteInterval;
+
+/** With periodic durability, the maximum number of seconds between each flush. Default: 5. */
+@property (nonatomic, assign) NSTimeInterval synchronizationTimeInterval;
+
 @end
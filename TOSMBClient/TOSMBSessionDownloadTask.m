@@ -22,11 +22,42 @@
 
 #import <CommonCrypto/CommonDigest.h>
 #import <UIKit/UIKit.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/xattr.h>
+#import <stdatomic.h>
 
 #import "TOSMBSessionDownloadTaskPrivate.h"
 #import "TOSMBSessionPrivate.h"
+#import "TOSMBBufferPool.h"
+#import "TOSMBChunkSizer.h"
 
 
+// The header at the start of the segment progress file. A resumed segmented download is
+// only continued if all of these values still match the file on the device.
+typedef struct {
+    uint32_t magic;
+    uint32_t segmentCount;
+    uint64_t fileSize;
+    uint64_t segmentSize;
+    uint64_t modificationTimestamp;
+} TOSMBDownloadSegmentHeader;
+
+static const uint32_t TOSMBDownloadSegmentMagic = 0x544f5347; // 'TOSG'
+
+// The most buffers a single download may have in flight between the network and the disk
+static const NSUInteger TOSMBDownloadMaximumPipelineBufferCount = 16;
+
+// The extended attribute on a partial download recording how much of it has definitely been flushed to disk,
+// and which version of the file on the device it came from
+static const char *TOSMBDownloadCheckpointAttributeName = "com.timoliver.tosmbclient.checkpoint";
+
+typedef struct {
+    uint64_t length;
+    uint64_t fileSize;
+    uint64_t modificationTimestamp;
+} TOSMBDownloadCheckpoint;
+
 // -------------------------------------------------------------------------
 
 @interface TOSMBSessionDownloadTask ()
@@ -40,21 +71,45 @@
 @property (assign, readwrite) int64_t countOfBytesReceived;
 @property (assign, readwrite) int64_t countOfBytesExpectedToReceive;
 
+@property (nonatomic, copy, readwrite) NSArray<NSValue *> *byteRanges;
+@property (strong, readwrite) NSArray<NSData *> *rangeData;
+@property (nonatomic, assign) BOOL downloadsRangesToMemory;
+
 /** Feedback handlers */
 @property (nonatomic, weak) id<TOSMBSessionDownloadTaskDelegate> delegate;
 @property (nonatomic, copy) void (^successHandler)(NSString *filePath);
+@property (nonatomic, copy) void (^dataSuccessHandler)(NSArray<NSData *> *data);
+
+/* Durability state */
+@property (nonatomic, assign) uint64_t bytesSinceSynchronization;
+@property (nonatomic, assign) CFAbsoluteTime lastSynchronizationTime;
 
 /* File Path Methods */
 - (NSString *)hashForFilePath;
 - (NSString *)filePathForTemporaryDestination;
+- (NSString *)filePathForSegmentProgress;
 - (NSString *)finalFilePathForDownloadedFile;
 - (NSString *)documentsDirectory;
 
 /* Feedback events sent to either the delegate or callback blocks */
 - (void)didSucceedWithFilePath:(NSString *)filePath;
-- (void)didUpdateWriteBytes:(uint64_t)bytesWritten totalBytesWritten:(uint64_t)totalBytesWritten totalBytesExpected:(uint64_t)totalBytesExpected;
+- (void)didSucceedWithRangeData:(NSArray<NSData *> *)data;
 - (void)didResumeAtOffset:(uint64_t)bytesWritten totalBytesExpected:(uint64_t)totalBytesExpected;
 
+/* Durability */
+- (BOOL)shouldSynchronizeAfterWritingBytes:(uint64_t)bytesWritten;
+- (void)checkpointFileDescriptor:(int)fileDescriptor length:(off_t)length;
+- (off_t)checkpointedLengthOfFileDescriptor:(int)fileDescriptor;
+
+/* Segmented downloading over multiple connections */
+- (BOOL)downloadSegmentsWithOperation:(__weak NSBlockOperation *)weakOperation
+                               treeID:(smb_tid)treeID
+                               fileID:(smb_fd)fileID
+                        formattedPath:(NSString *)formattedPath;
+
+/* Downloading only the requested byte ranges */
+- (BOOL)downloadByteRangesWithOperation:(__weak NSBlockOperation *)weakOperation fileID:(smb_fd)fileID;
+
 @end
 
 @implementation TOSMBSessionDownloadTask
@@ -78,6 +133,12 @@
         self.delegate = delegate;
         
         _tempFilePath = [self filePathForTemporaryDestination];
+        _maximumConnectionCount = 1;
+        _segmentSize = 4 * 1024 * 1024;
+        _pipelineBufferCount = 4;
+        _durability = TOSMBSessionDownloadDurabilityEveryChunk;
+        _synchronizationByteInterval = 8 * 1024 * 1024;
+        _synchronizationTimeInterval = 5;
     }
     
     return self;
@@ -95,6 +156,27 @@
         self.failHandler = failHandler;
         
         _tempFilePath = [self filePathForTemporaryDestination];
+        _maximumConnectionCount = 1;
+        _segmentSize = 4 * 1024 * 1024;
+        _pipelineBufferCount = 4;
+        _durability = TOSMBSessionDownloadDurabilityEveryChunk;
+        _synchronizationByteInterval = 8 * 1024 * 1024;
+        _synchronizationTimeInterval = 5;
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session filePath:(NSString *)filePath byteRanges:(NSArray<NSValue *> *)byteRanges destinationPath:(NSString *)destinationPath progressHandler:(id)progressHandler successHandler:(id)successHandler failHandler:(id)failHandler
+{
+    BOOL toMemory = (destinationPath == nil);
+    if ((self = [self initWithSession:session filePath:filePath destinationPath:destinationPath progressHandler:progressHandler successHandler:(toMemory ? nil : successHandler) failHandler:failHandler])) {
+        _byteRanges = [byteRanges copy] ?: @[];
+        _downloadsRangesToMemory = toMemory;
+        _dataSuccessHandler = toMemory ? successHandler : nil;
+        
+        //Partial files are never resumed, so keep them apart from any full download of the same file
+        _tempFilePath = [[self filePathForTemporaryDestination] stringByAppendingPathExtension:@"ranges"];
     }
     
     return self;
@@ -117,6 +199,11 @@
     return [NSTemporaryDirectory() stringByAppendingPathComponent:fileName];
 }
 
+- (NSString *)filePathForSegmentProgress
+{
+    return [self.tempFilePath stringByAppendingPathExtension:@"segments"];
+}
+
 - (NSString *)hashForFilePath
 {
     NSString *filePath = self.sourceFilePath.lowercaseString;
@@ -183,6 +270,7 @@
     
     id deleteBlock = ^{
         [[NSFileManager defaultManager] removeItemAtPath:self.tempFilePath error:nil];
+        [[NSFileManager defaultManager] removeItemAtPath:[self filePathForSegmentProgress] error:nil];
     };
     
     NSBlockOperation *deleteOperation = [[NSBlockOperation alloc] init];
@@ -204,6 +292,14 @@
     if ([[NSFileManager defaultManager] fileExistsAtPath:self.tempFilePath] == NO)
         return NO;
     
+    //A partial file's own modification date is only set once the download stops, so it won't match after a crash.
+    //Its checkpoint records the file it came from instead.
+    TOSMBDownloadCheckpoint checkpoint;
+    if (getxattr(self.tempFilePath.fileSystemRepresentation, TOSMBDownloadCheckpointAttributeName, &checkpoint, sizeof(checkpoint), 0, 0) == sizeof(checkpoint)) {
+        return (checkpoint.fileSize == self.file.fileSize &&
+                checkpoint.modificationTimestamp == self.file.modificationTimestamp);
+    }
+    
     NSDate *modificationTime = [[[NSFileManager defaultManager] attributesOfItemAtPath:self.tempFilePath error:nil] fileModificationDate];
     if ([modificationTime isEqual:self.file.modificationTime] == NO) {
         return NO;
@@ -214,43 +310,61 @@
 
 - (void)didSucceedWithFilePath:(NSString *)filePath
 {
-    dispatch_sync(dispatch_get_main_queue(), ^{
+    [self performDelegateBlock:^{
         if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didFinishDownloadingToPath:)])
             [self.delegate downloadTask:self didFinishDownloadingToPath:filePath];
         
         if (self.successHandler)
             self.successHandler(filePath);
-    });
+    }];
+}
+
+- (void)didSucceedWithRangeData:(NSArray<NSData *> *)data
+{
+    [self performDelegateBlock:^{
+        if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didFinishDownloadingRangeData:)])
+            [self.delegate downloadTask:self didFinishDownloadingRangeData:data];
+        
+        if (self.dataSuccessHandler)
+            self.dataSuccessHandler(data);
+    }];
 }
 
 - (void)didFailWithError:(NSError *)error
 {
+    //The superclass calls the fail handler; only the legacy delegate method remains
     [super didFailWithError:error];
-    dispatch_sync(dispatch_get_main_queue(), ^{
+    [self performDelegateBlock:^{
         if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didCompleteWithError:)])
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
             [self.delegate downloadTask:self didCompleteWithError:error];
-#pragma clang diagnostic pop        
-        if (self.failHandler)
-            self.failHandler(error);
-    });
+#pragma clang diagnostic pop
+    }];
 }
 
-- (void)didUpdateWriteBytes:(uint64_t)bytesWritten totalBytesWritten:(uint64_t)totalBytesWritten totalBytesExpected:(uint64_t)totalBytesExpected
+- (uint64_t)progressBytesCompleted
 {
-    [[NSOperationQueue mainQueue] addOperationWithBlock:^{
-        if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didWriteBytes:totalBytesReceived:totalBytesExpectedToReceive:)])
-            [self.delegate downloadTask:self didWriteBytes:bytesWritten totalBytesReceived:self.countOfBytesReceived totalBytesExpectedToReceive:self.countOfBytesExpectedToReceive];
-        
-        if (self.progressHandler)
-            self.progressHandler(self.countOfBytesReceived, self.countOfBytesExpectedToReceive);
-    }];
+    return self.countOfBytesReceived;
+}
+
+- (uint64_t)progressBytesExpected
+{
+    return self.countOfBytesExpectedToReceive;
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected
+{
+    if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didWriteBytes:totalBytesReceived:totalBytesExpectedToReceive:)])
+        [self.delegate downloadTask:self didWriteBytes:bytes totalBytesReceived:totalBytes totalBytesExpectedToReceive:totalBytesExpected];
+    
+    if (self.progressHandler)
+        self.progressHandler(totalBytes, totalBytesExpected);
 }
 
 - (void)didResumeAtOffset:(uint64_t)bytesWritten totalBytesExpected:(uint64_t)totalBytesExpected
 {
-    [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+    [self performDelegateBlock:^{
         if (self.delegate && [self.delegate respondsToSelector:@selector(downloadTask:didResumeAtOffset:totalBytesExpectedToReceive:)])
             [self.delegate downloadTask:self didResumeAtOffset:bytesWritten totalBytesExpectedToReceive:totalBytesExpected];
     }];
@@ -269,14 +383,10 @@
     //---------------------------------------------------------------------------------------
     //Connect to SMB device
     
-    self.smbSession = smb_session_new();
-    
-    //First, check to make sure the server is there, and to acquire its attributes
-    __block NSError *error = nil;
-    dispatch_sync(self.session.serialQueue, ^{
-        error = [self.session attemptConnectionWithSessionPointer:self.smbSession];
-    });
-    if (error) {
+    //Borrow a logged-in connection from the session, or connect and log in if none are available
+    NSError *error = nil;
+    self.connection = [self.session dequeueConnectionWithError:&error];
+    if (self.connection == nil) {
         [self didFailWithError:error];
         self.cleanupBlock(treeID, fileID);
         return;
@@ -290,12 +400,11 @@
     //---------------------------------------------------------------------------------------
     //Connect to share
     
-    //Next attach to the share we'll be using
+    //Next attach to the share we'll be using (This is a no-op if the pooled connection already did)
     NSString *shareName = [self.session shareNameFromPath:self.sourceFilePath];
-    const char *shareCString = [shareName cStringUsingEncoding:NSUTF8StringEncoding];
-    
-    if (smb_tree_connect(self.smbSession, shareCString, &treeID) != 0) {
-        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeShareConnectionFailed)];
+    error = [self.connection connectToShareWithName:shareName treeID:&treeID];
+    if (error) {
+        [self didFailWithError:error];
         self.cleanupBlock(treeID, fileID);
         return;
     }
@@ -313,7 +422,10 @@
     formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
     
     //Get the file info we'll be working off
-    self.file = [self requestFileForItemAtPath:formattedPath inTree:treeID];
+    [self.connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        self.file = [self requestFileForItemAtPath:formattedPath inTree:shareTreeID];
+        return (self.file != nil);
+    }];
     if (self.file == nil) {
         [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileNotFound)];
         self.cleanupBlock(treeID, fileID);
@@ -349,20 +461,84 @@
     }
     
     
+    //---------------------------------------------------------------------------------------
+    //Download only the requested parts of the file
+    
+    if (self.byteRanges) {
+        BOOL success = [self downloadByteRangesWithOperation:weakOperation fileID:fileID];
+        if (success == NO || weakOperation.isCancelled || self.state != TOSMBSessionTaskStateRunning) {
+            self.cleanupBlock(treeID, fileID);
+            return;
+        }
+        
+        self.state = TOSMBSessionTaskStateCompleted;
+        
+        if (self.downloadsRangesToMemory) {
+            [self didSucceedWithRangeData:self.rangeData];
+        }
+        else {
+            NSString *finalDestinationPath = [self finalFilePathForDownloadedFile];
+            [[NSFileManager defaultManager] moveItemAtPath:self.tempFilePath toPath:finalDestinationPath error:nil];
+            [self didSucceedWithFilePath:finalDestinationPath];
+        }
+        
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
     //---------------------------------------------------------------------------------------
     //Start downloading
     
     //Create the directories to the download destination
     [[NSFileManager defaultManager] createDirectoryAtPath:[self.tempFilePath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
     
+    //Large files can be split into segments, and downloaded over several connections at once
+    uint64_t segmentSize = MAX(self.segmentSize, 65535);
+    if (self.maximumConnectionCount > 1 && self.file.fileSize >= segmentSize * 2) {
+        BOOL success = [self downloadSegmentsWithOperation:weakOperation treeID:treeID fileID:fileID formattedPath:formattedPath];
+        if (success == NO || weakOperation.isCancelled || self.state != TOSMBSessionTaskStateRunning) {
+            self.cleanupBlock(treeID, fileID);
+            return;
+        }
+        
+        NSString *finalDestinationPath = [self finalFilePathForDownloadedFile];
+        [[NSFileManager defaultManager] moveItemAtPath:self.tempFilePath toPath:finalDestinationPath error:nil];
+        
+        self.state = TOSMBSessionTaskStateCompleted;
+        [self didSucceedWithFilePath:finalDestinationPath];
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
     //Create a new blank file to write to
     if (self.canBeResumed == NO)
         [[NSFileManager defaultManager] createFileAtPath:self.tempFilePath contents:nil attributes:nil];
     
-    //Open a handle to the file and skip ahead if we're resuming
-    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:self.tempFilePath];
-    unsigned long long seekOffset = (ssize_t)[fileHandle seekToEndOfFile];
+    //Open the file and skip ahead if we're resuming
+    int fileDescriptor = open(self.tempFilePath.fileSystemRepresentation, O_WRONLY);
+    if (fileDescriptor < 0) {
+        [self fail];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
+    off_t seekOffset = lseek(fileDescriptor, 0, SEEK_END);
+    
+    //Anything past the last checkpoint may not have made it to disk intact, so throw it away and download it again
+    off_t checkpointedLength = [self checkpointedLengthOfFileDescriptor:fileDescriptor];
+    if (checkpointedLength >= 0 && checkpointedLength < seekOffset) {
+        ftruncate(fileDescriptor, checkpointedLength);
+        seekOffset = checkpointedLength;
+    }
+    
+    //Record where the file came from straight away, so it can be resumed even if the app dies before the first flush
+    [self checkpointFileDescriptor:fileDescriptor length:seekOffset];
+    
     self.countOfBytesReceived = seekOffset;
+    self.progressBytesDelivered = seekOffset;
+    self.bytesSinceSynchronization = 0;
+    self.lastSynchronizationTime = CFAbsoluteTimeGetCurrent();
     
     //Create a background handle so the download will continue even if the app is suspended
     self.backgroundTaskIdentifier = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{ [self suspend]; }];
@@ -372,41 +548,106 @@
         [self didResumeAtOffset:seekOffset totalBytesExpected:self.countOfBytesExpectedToReceive];
     }
     
-    //Perform the file download
+    //Perform the file download. Reading from the network and writing to disk overlap; while filled
+    //buffers are written out on the write queue, we carry on reading into the next free buffer.
+    NSUInteger bufferCount = MIN(MAX(1, self.pipelineBufferCount), TOSMBDownloadMaximumPipelineBufferCount);
+    
+    //Borrow the buffers from the session, so they're reused by the next task rather than being allocated again
+    TOSMBBufferPool *bufferPool = self.session.bufferPool;
+    size_t bufferSize = bufferPool.bufferSize;
+    char *buffers[TOSMBDownloadMaximumPipelineBufferCount] = {NULL};
+    BOOL buffersAvailable = YES;
+    for (NSUInteger i = 0; i < bufferCount; i++) {
+        buffers[i] = [bufferPool dequeueBuffer];
+        buffersAvailable = buffersAvailable && (buffers[i] != NULL);
+    }
+    
+    dispatch_semaphore_t freeBuffers = dispatch_semaphore_create(bufferCount);
+    dispatch_queue_t writeQueue = dispatch_queue_create("com.timoliver.tosmbclient.download.write", DISPATCH_QUEUE_SERIAL);
+    
+    TOSMBChunkSizer *chunkSizer = self.session.readChunkSizer;
+    off_t readOffset = seekOffset;
+    
+    //Set on the write queue but checked by this thread between reads
+    __block atomic_bool writeFailed = (buffersAvailable == NO);
+    __block off_t writeOffset = seekOffset;
     int64_t bytesRead = 0;
-    NSInteger bufferSize = 65535;
-    char *buffer = malloc(bufferSize);
+    NSUInteger bufferIndex = 0;
     
     do {
-        //Read the bytes from the network device
-        bytesRead = smb_fread(self.smbSession, fileID, buffer, bufferSize);
-        if (bytesRead < 0) {
-            [self fail];
-            [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        //Wait until there's a buffer that isn't still waiting to be written
+        dispatch_semaphore_wait(freeBuffers, DISPATCH_TIME_FOREVER);
+        if (writeFailed || weakOperation.isCancelled) {
+            dispatch_semaphore_signal(freeBuffers);
             break;
         }
         
-        //Save them to the file handle (And ensure the NSData object is flushed immediately)
-        @autoreleasepool {
-            [fileHandle writeData:[NSData dataWithBytes:buffer length:(NSUInteger)bytesRead]];
-        }
+        char *buffer = buffers[bufferIndex++ % bufferCount];
         
-        //Ensure the data is properly written to disk before proceeding
-        [fileHandle synchronizeFile];
+        //Read the bytes from the network device, in a chunk sized to suit the current network conditions
+        size_t chunkSize = MIN(chunkSizer.chunkSize, bufferSize);
+        CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+        bytesRead = smb_fread(self.smbSession, fileID, buffer, chunkSize);
+        if (bytesRead >= 0) {
+            readOffset += bytesRead;
+            [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                               requestedBytes:chunkSize
+                                     duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                    endOfFile:(readOffset >= self.countOfBytesExpectedToReceive)];
+        }
         
-        if (weakOperation.isCancelled)
+        if (bytesRead <= 0) {
+            dispatch_semaphore_signal(freeBuffers);
+            
+            if (bytesRead < 0) {
+                self.connection.invalid = YES;
+                [self fail];
+                [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+            }
             break;
+        }
         
-        self.countOfBytesReceived += bytesRead;
-        
-        [self didUpdateWriteBytes:bytesRead totalBytesWritten:self.countOfBytesReceived totalBytesExpected:self.countOfBytesExpectedToReceive];
+        //Hand the buffer over to be written at its offset in the file
+        dispatch_async(writeQueue, ^{
+            if (writeFailed == NO) {
+                if (pwrite(fileDescriptor, buffer, (size_t)bytesRead, writeOffset) == bytesRead) {
+                    writeOffset += bytesRead;
+                    
+                    //Flush to disk as often as the durability setting asks for
+                    if ([self shouldSynchronizeAfterWritingBytes:bytesRead])
+                        [self checkpointFileDescriptor:fileDescriptor length:writeOffset];
+                    
+                    self.countOfBytesReceived += bytesRead;
+                    [self didUpdateProgress];
+                }
+                else {
+                    writeFailed = YES;
+                }
+            }
+            
+            dispatch_semaphore_signal(freeBuffers);
+        });
     } while (bytesRead > 0);
     
+    //Wait for any buffers still in flight to be written, and then flush everything, whether we finished or were stopped
+    dispatch_sync(writeQueue, ^{});
+    [self checkpointFileDescriptor:fileDescriptor length:writeOffset];
+    
+    //The checkpoint is only needed while the file is incomplete
+    if (weakOperation.isCancelled == NO && self.state == TOSMBSessionTaskStateRunning)
+        fremovexattr(fileDescriptor, TOSMBDownloadCheckpointAttributeName, 0);
+    
+    if (writeFailed && self.state == TOSMBSessionTaskStateRunning) {
+        [self fail];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+    }
+    
     //Set the modification date to match the one on the SMB device so we can compare the two at a later date
     [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate:self.file.modificationTime} ofItemAtPath:self.tempFilePath error:nil];
     
-    free(buffer);
-    [fileHandle closeFile];
+    for (NSUInteger i = 0; i < bufferCount; i++)
+        [bufferPool enqueueBuffer:buffers[i]];
+    close(fileDescriptor);
     
     if (weakOperation.isCancelled  || self.state != TOSMBSessionTaskStateRunning) {
         self.cleanupBlock(treeID, fileID);
@@ -429,4 +670,439 @@
     self.cleanupBlock(treeID, fileID);
 }
 
+#pragma mark - Byte Ranges -
+
+- (NSArray<NSValue *> *)rangesToFetchForFileSize:(uint64_t)fileSize
+{
+    //Clip each range to the end of the file
+    NSMutableArray<NSValue *> *ranges = [NSMutableArray arrayWithCapacity:self.byteRanges.count];
+    for (NSValue *value in self.byteRanges) {
+        NSRange range = value.rangeValue;
+        uint64_t start = MIN((uint64_t)range.location, fileSize);
+        uint64_t end = MIN((uint64_t)range.location + range.length, fileSize);
+        [ranges addObject:[NSValue valueWithRange:NSMakeRange((NSUInteger)start, (NSUInteger)(end - start))]];
+    }
+    
+    //Every range gets its own data when downloading into memory
+    if (self.downloadsRangesToMemory)
+        return ranges;
+    
+    //When downloading to a file, overlapping ranges are merged so no part of the file is fetched twice
+    [ranges sortUsingComparator:^NSComparisonResult(NSValue *first, NSValue *second) {
+        NSUInteger firstLocation = first.rangeValue.location;
+        NSUInteger secondLocation = second.rangeValue.location;
+        if (firstLocation == secondLocation)
+            return NSOrderedSame;
+        return (firstLocation < secondLocation) ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    
+    NSMutableArray<NSValue *> *mergedRanges = [NSMutableArray arrayWithCapacity:ranges.count];
+    for (NSValue *value in ranges) {
+        NSRange range = value.rangeValue;
+        if (range.length == 0)
+            continue;
+        
+        NSRange lastRange = mergedRanges.lastObject.rangeValue;
+        if (mergedRanges.count > 0 && range.location <= NSMaxRange(lastRange)) {
+            lastRange.length = MAX(NSMaxRange(lastRange), NSMaxRange(range)) - lastRange.location;
+            mergedRanges[mergedRanges.count - 1] = [NSValue valueWithRange:lastRange];
+            continue;
+        }
+        
+        [mergedRanges addObject:value];
+    }
+    
+    return mergedRanges;
+}
+
+- (BOOL)downloadByteRangesWithOperation:(__weak NSBlockOperation *)weakOperation fileID:(smb_fd)fileID
+{
+    uint64_t fileSize = self.file.fileSize;
+    NSArray<NSValue *> *ranges = [self rangesToFetchForFileSize:fileSize];
+    BOOL toMemory = self.downloadsRangesToMemory;
+    
+    //Progress only counts the bytes that were asked for. Partial downloads aren't resumed, so always start from scratch.
+    uint64_t expectedBytes = 0;
+    for (NSValue *value in ranges)
+        expectedBytes += value.rangeValue.length;
+    
+    self.countOfBytesExpectedToReceive = expectedBytes;
+    self.countOfBytesReceived = 0;
+    self.progressBytesDelivered = 0;
+    self.rangeData = nil;
+    
+    //Ranges are written at their own offsets in a file the size of the original, leaving the rest of it as holes
+    int fileDescriptor = -1;
+    if (toMemory == NO) {
+        [[NSFileManager defaultManager] createDirectoryAtPath:[self.tempFilePath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+        fileDescriptor = open(self.tempFilePath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fileDescriptor < 0 || ftruncate(fileDescriptor, (off_t)fileSize) != 0) {
+            if (fileDescriptor >= 0) {
+                close(fileDescriptor);
+                unlink(self.tempFilePath.fileSystemRepresentation);
+            }
+            
+            [self fail];
+            [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+            return NO;
+        }
+    }
+    
+    //Create a background handle so the download will continue even if the app is suspended
+    self.backgroundTaskIdentifier = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{ [self suspend]; }];
+    
+    //Data downloaded into memory is read straight into its final buffer; otherwise a pooled buffer is reused for every chunk
+    TOSMBBufferPool *bufferPool = self.session.bufferPool;
+    char *buffer = toMemory ? NULL : [bufferPool dequeueBuffer];
+    size_t bufferSize = bufferPool.bufferSize;
+    TOSMBChunkSizer *chunkSizer = self.session.readChunkSizer;
+    
+    NSMutableArray<NSData *> *rangeData = toMemory ? [NSMutableArray arrayWithCapacity:ranges.count] : nil;
+    BOOL failed = (toMemory == NO && buffer == NULL);
+    
+    for (NSValue *value in ranges) {
+        if (failed || weakOperation.isCancelled)
+            break;
+        
+        NSRange range = value.rangeValue;
+        uint64_t offset = range.location;
+        uint64_t end = NSMaxRange(range);
+        NSMutableData *data = toMemory ? [NSMutableData dataWithLength:range.length] : nil;
+        
+        smb_fseek(self.smbSession, fileID, (off_t)offset, SMB_SEEK_SET);
+        
+        while (offset < end && weakOperation.isCancelled == NO) {
+            size_t chunkSize = (size_t)MIN((uint64_t)MIN(chunkSizer.chunkSize, bufferSize), end - offset);
+            char *destination = toMemory ? (char *)data.mutableBytes + (offset - range.location) : buffer;
+            
+            CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+            ssize_t bytesRead = smb_fread(self.smbSession, fileID, destination, chunkSize);
+            if (bytesRead >= 0) {
+                [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                                   requestedBytes:chunkSize
+                                         duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                        endOfFile:(offset + bytesRead >= fileSize)];
+            }
+            
+            if (bytesRead < 0) {
+                self.connection.invalid = YES;
+                failed = YES;
+                break;
+            }
+            
+            //The file is shorter than it was when we started; stop expecting the rest of this range
+            if (bytesRead == 0) {
+                self.countOfBytesExpectedToReceive -= (end - offset);
+                [self didUpdateProgress];
+                break;
+            }
+            
+            if (toMemory == NO && pwrite(fileDescriptor, buffer, bytesRead, (off_t)offset) != bytesRead) {
+                failed = YES;
+                break;
+            }
+            
+            offset += bytesRead;
+            self.countOfBytesReceived += bytesRead;
+            [self didUpdateProgress];
+        }
+        
+        if (data) {
+            data.length = (NSUInteger)(offset - range.location);
+            [rangeData addObject:data];
+        }
+    }
+    
+    if (buffer)
+        [bufferPool enqueueBuffer:buffer];
+    
+    //Partial downloads restart from scratch when resumed, so there's nothing to checkpoint along the way.
+    //The data is only flushed once, before the file is handed over.
+    if (fileDescriptor >= 0) {
+        if (failed == NO && weakOperation.isCancelled == NO && fsync(fileDescriptor) != 0)
+            failed = YES;
+        
+        close(fileDescriptor);
+        
+        //Nothing in the file can be reused by the next attempt, so don't leave a file of mostly holes lying around
+        if (failed || weakOperation.isCancelled)
+            unlink(self.tempFilePath.fileSystemRepresentation);
+    }
+    
+    if (failed && self.state == TOSMBSessionTaskStateRunning) {
+        [self fail];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+    }
+    
+    if (failed || weakOperation.isCancelled)
+        return NO;
+    
+    self.rangeData = rangeData;
+    return YES;
+}
+
+#pragma mark - Durability -
+
+- (BOOL)shouldSynchronizeAfterWritingBytes:(uint64_t)bytesWritten
+{
+    switch (self.durability) {
+        case TOSMBSessionDownloadDurabilityEveryChunk:
+            return YES;
+        case TOSMBSessionDownloadDurabilityOnCompletion:
+            return NO;
+        case TOSMBSessionDownloadDurabilityPeriodic:
+            break;
+    }
+    
+    self.bytesSinceSynchronization += bytesWritten;
+    
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (self.bytesSinceSynchronization < self.synchronizationByteInterval &&
+        now - self.lastSynchronizationTime < self.synchronizationTimeInterval) {
+        return NO;
+    }
+    
+    self.bytesSinceSynchronization = 0;
+    self.lastSynchronizationTime = now;
+    return YES;
+}
+
+- (void)checkpointFileDescriptor:(int)fileDescriptor length:(off_t)length
+{
+    fsync(fileDescriptor);
+    
+    TOSMBDownloadCheckpoint checkpoint;
+    checkpoint.length = (uint64_t)length;
+    checkpoint.fileSize = self.file.fileSize;
+    checkpoint.modificationTimestamp = self.file.modificationTimestamp;
+    fsetxattr(fileDescriptor, TOSMBDownloadCheckpointAttributeName, &checkpoint, sizeof(checkpoint), 0, 0);
+}
+
+- (off_t)checkpointedLengthOfFileDescriptor:(int)fileDescriptor
+{
+    //Files without a checkpoint (eg, from older versions) are trusted up to their full length
+    TOSMBDownloadCheckpoint checkpoint;
+    if (fgetxattr(fileDescriptor, TOSMBDownloadCheckpointAttributeName, &checkpoint, sizeof(checkpoint), 0, 0) != sizeof(checkpoint))
+        return -1;
+    
+    return (off_t)checkpoint.length;
+}
+
+#pragma mark - Segmented Downloading -
+
+- (BOOL)downloadSegmentsWithOperation:(__weak NSBlockOperation *)weakOperation
+                               treeID:(smb_tid)treeID
+                               fileID:(smb_fd)fileID
+                        formattedPath:(NSString *)formattedPath
+{
+    uint64_t fileSize = self.file.fileSize;
+    uint64_t segmentSize = MAX(self.segmentSize, 65535);
+    uint32_t segmentCount = (uint32_t)((fileSize + segmentSize - 1) / segmentSize);
+    size_t progressSize = segmentCount * sizeof(uint64_t);
+    
+    //Open the temporary file, and the file recording how much of each segment has been written to it
+    NSString *progressFilePath = [self filePathForSegmentProgress];
+    int dataFile = open(self.tempFilePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    int progressFile = open(progressFilePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    if (dataFile < 0 || progressFile < 0) {
+        if (dataFile >= 0) { close(dataFile); }
+        if (progressFile >= 0) { close(progressFile); }
+        [self fail];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        return NO;
+    }
+    
+    TOSMBDownloadSegmentHeader header = {0};
+    header.magic = TOSMBDownloadSegmentMagic;
+    header.segmentCount = segmentCount;
+    header.fileSize = fileSize;
+    header.segmentSize = segmentSize;
+    header.modificationTimestamp = self.file.modificationTimestamp;
+    
+    //If a previous attempt downloaded the same version of this file, carry on from where each segment left off
+    uint64_t *segmentProgress = calloc(segmentCount, sizeof(uint64_t));
+    TOSMBDownloadSegmentHeader existingHeader = {0};
+    BOOL canResume = (pread(progressFile, &existingHeader, sizeof(existingHeader), 0) == sizeof(existingHeader) &&
+                      memcmp(&existingHeader, &header, sizeof(header)) == 0 &&
+                      pread(progressFile, segmentProgress, progressSize, sizeof(header)) == (ssize_t)progressSize);
+    
+    if (canResume == NO) {
+        memset(segmentProgress, 0, progressSize);
+        ftruncate(dataFile, 0);
+        ftruncate(dataFile, (off_t)fileSize);
+        ftruncate(progressFile, 0);
+        pwrite(progressFile, &header, sizeof(header), 0);
+        pwrite(progressFile, segmentProgress, progressSize, sizeof(header));
+    }
+    
+    uint64_t resumedBytes = 0;
+    for (uint32_t i = 0; i < segmentCount; i++)
+        resumedBytes += segmentProgress[i];
+    
+    self.countOfBytesReceived = resumedBytes;
+    self.progressBytesDelivered = resumedBytes;
+    if (resumedBytes > 0)
+        [self didResumeAtOffset:resumedBytes totalBytesExpected:fileSize];
+    
+    //Create a background handle so the download will continue even if the app is suspended
+    self.backgroundTaskIdentifier = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{ [self suspend]; }];
+    
+    NSString *shareName = [self.session shareNameFromPath:self.sourceFilePath];
+    const char *filePath = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    NSUInteger workerCount = MIN(self.maximumConnectionCount, (NSUInteger)segmentCount);
+    NSLock *lock = [[NSLock alloc] init];
+    
+    //The progress file is only updated after the data it describes has been flushed. The progress is copied
+    //before flushing, so any bytes it counts were already written to the file by the time fsync() runs.
+    //Checkpoints have their own lock, so the other workers can keep claiming segments while one is being flushed.
+    self.bytesSinceSynchronization = 0;
+    self.lastSynchronizationTime = CFAbsoluteTimeGetCurrent();
+    uint64_t *progressSnapshot = malloc(progressSize);
+    NSLock *checkpointLock = [[NSLock alloc] init];
+    void (^checkpoint)(void) = ^{
+        memcpy(progressSnapshot, segmentProgress, progressSize);
+        fsync(dataFile);
+        pwrite(progressFile, progressSnapshot, progressSize, sizeof(header));
+    };
+    __block uint32_t nextSegment = 0;
+    __block BOOL failed = NO;
+    
+    //Each worker keeps taking the next unfinished segment until there are none left.
+    //The first worker uses the task's own connection, and the rest borrow connections from the session's pool.
+    [self performWithWorkerCount:workerCount usingBlock:^(NSUInteger worker) {
+        TOSMBConnection *connection = self.connection;
+        smb_fd workerFileID = (worker == 0) ? fileID : 0;
+        
+        if (worker > 0) {
+            smb_tid workerTreeID = 0;
+            connection = [self.session dequeueConnectionWithError:nil];
+            if (connection == nil)
+                return;
+            
+            if ([connection connectToShareWithName:shareName treeID:&workerTreeID] == nil)
+                smb_fopen(connection.session, workerTreeID, filePath, SMB_MOD_RO, &workerFileID);
+            
+            if (!workerFileID) {
+                [self.session enqueueConnection:connection];
+                return;
+            }
+        }
+        
+        TOSMBChunkSizer *chunkSizer = self.session.readChunkSizer;
+        size_t bufferSize = self.session.bufferPool.bufferSize;
+        char *buffer = [self.session.bufferPool dequeueBuffer];
+        if (buffer == NULL) {
+            [lock lock];
+            failed = YES;
+            [lock unlock];
+        }
+        
+        while (buffer && weakOperation.isCancelled == NO) {
+            //Claim the next segment that still has bytes missing
+            [lock lock];
+            uint32_t segment = nextSegment;
+            while (segment < segmentCount && segmentProgress[segment] >= MIN(segmentSize, fileSize - (segment * segmentSize)))
+                segment++;
+            nextSegment = segment + 1;
+            BOOL stop = failed;
+            [lock unlock];
+            
+            if (segment >= segmentCount || stop)
+                break;
+            
+            uint64_t segmentStart = segment * segmentSize;
+            uint64_t segmentEnd = MIN(segmentStart + segmentSize, fileSize);
+            uint64_t offset = segmentStart + segmentProgress[segment];
+            
+            smb_fseek(connection.session, workerFileID, (ssize_t)offset, SMB_SEEK_SET);
+            
+            while (offset < segmentEnd && weakOperation.isCancelled == NO) {
+                size_t chunkSize = (size_t)MIN((uint64_t)MIN(chunkSizer.chunkSize, bufferSize), segmentEnd - offset);
+                CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+                ssize_t bytesRead = smb_fread(connection.session, workerFileID, buffer, chunkSize);
+                if (bytesRead >= 0) {
+                    [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                                       requestedBytes:chunkSize
+                                             duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                            endOfFile:(offset + bytesRead >= fileSize)];
+                }
+                
+                if (bytesRead <= 0 || pwrite(dataFile, buffer, bytesRead, (off_t)offset) != bytesRead) {
+                    if (bytesRead < 0)
+                        connection.invalid = YES;
+                    
+                    [lock lock];
+                    failed = YES;
+                    [lock unlock];
+                    break;
+                }
+                
+                offset += bytesRead;
+                
+                //Only this worker writes to this segment's entry, so it can be updated without locking
+                segmentProgress[segment] += bytesRead;
+                
+                [lock lock];
+                BOOL synchronize = [self shouldSynchronizeAfterWritingBytes:bytesRead];
+                [lock unlock];
+                
+                //If another worker is already checkpointing, its snapshot will do
+                if (synchronize && [checkpointLock tryLock]) {
+                    checkpoint();
+                    [checkpointLock unlock];
+                }
+                
+                @synchronized (self) {
+                    self.countOfBytesReceived += bytesRead;
+                }
+                
+                [self didUpdateProgress];
+            }
+            
+            [lock lock];
+            stop = failed;
+            [lock unlock];
+            if (stop)
+                break;
+        }
+        
+        [self.session.bufferPool enqueueBuffer:buffer];
+        
+        if (worker > 0) {
+            smb_fclose(connection.session, workerFileID);
+            [self.session enqueueConnection:connection];
+        }
+    }];
+    
+    //Save the progress so far, in case we were suspended
+    checkpoint();
+    free(progressSnapshot);
+    
+    //Make sure every segment was actually downloaded (eg, in case none of the extra connections could be made)
+    BOOL complete = (failed == NO);
+    for (uint32_t i = 0; i < segmentCount && complete; i++)
+        complete = (segmentProgress[i] >= MIN(segmentSize, fileSize - (i * segmentSize)));
+    
+    free(segmentProgress);
+    close(dataFile);
+    close(progressFile);
+    
+    if (weakOperation.isCancelled)
+        return NO;
+    
+    if (complete == NO) {
+        [self fail];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        return NO;
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:progressFilePath error:nil];
+    
+    //Set the modification date to match the one on the SMB device so we can compare the two at a later date
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate:self.file.modificationTime} ofItemAtPath:self.tempFilePath error:nil];
+    
+    return YES;
+}
+
 @end
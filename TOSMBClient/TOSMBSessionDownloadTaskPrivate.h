@@ -41,6 +41,20 @@
                  successHandler:(id)successHandler
                     failHandler:(id)failHandler;
 
+/* Only downloads the supplied byte ranges. If the destination path is nil, the ranges are downloaded
+   into memory, and the success handler is passed their data instead of a file path. */
+- (instancetype)initWithSession:(TOSMBSession *)session
+                       filePath:(NSString *)filePath
+                     byteRanges:(NSArray<NSValue *> *)byteRanges
+                destinationPath:(NSString *)destinationPath
+                progressHandler:(id)progressHandler
+                 successHandler:(id)successHandler
+                    failHandler:(id)failHandler;
+
+/* The byte ranges to download, clipped to the end of the file. When downloading to a file,
+   they're also sorted and merged, so no part of the file is fetched twice. */
+- (NSArray<NSValue *> *)rangesToFetchForFileSize:(uint64_t)fileSize;
+
 @end
 
 #endif /* TOSMBSessionDownloadTaskPrivate_h */
@@ -27,6 +27,7 @@
 @interface TOSMBSessionFile ()
 
 @property (nonatomic, strong, readwrite) NSString *filePath;
+@property (nonatomic, copy) NSString *parentDirectoryFilePath;
 
 @property (nonatomic, assign) smb_stat stat;
 @property (nonatomic, assign) BOOL isShareRoot; /** If this item represents the root network share */
@@ -38,11 +39,6 @@
 @property (nonatomic, assign, readwrite) uint64_t allocationSize;
 @property (nonatomic, assign, readwrite) BOOL directory;
 
-@property (nonatomic, assign) uint64_t modificationTimestamp;
-@property (nonatomic, assign) uint64_t creationTimestamp;
-@property (nonatomic, assign) uint64_t accessTimestamp;
-@property (nonatomic, assign) uint64_t writeTimestamp;
-
 @property (nonatomic, strong, readwrite) NSDate *modificationTime;
 @property (nonatomic, strong, readwrite) NSDate *creationTime;
 @property (nonatomic, strong, readwrite) NSDate *accessTime;
@@ -52,6 +48,29 @@
 
 @end
 
+// The number of seconds between the FILETIME epoch (1601-01-01) and the
+// NSDate reference date (2001-01-01); 400 Gregorian years, or 146,097 days.
+static const NSTimeInterval TOSMBFileTimeToReferenceDateOffset = 12622780800.0;
+
+NSDate *TOSMBDateFromFileTime(uint64_t fileTime)
+{
+    //FILETIME values are in 100-nanosecond intervals
+    NSTimeInterval seconds = (NSTimeInterval)fileTime / 10000000.0;
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:seconds - TOSMBFileTimeToReferenceDateOffset];
+}
+
+uint64_t TOSMBFileTimeFromDate(NSDate *date)
+{
+    if (date == nil)
+        return 0;
+    
+    NSTimeInterval seconds = date.timeIntervalSinceReferenceDate + TOSMBFileTimeToReferenceDateOffset;
+    if (seconds <= 0)
+        return 0;
+    
+    return (uint64_t)(seconds * 10000000.0);
+}
+
 @implementation TOSMBSessionFile
 
 - (instancetype)init
@@ -82,10 +101,39 @@
         _accessTimestamp = smb_stat_get(stat, SMB_STAT_ATIME);
         _writeTimestamp = smb_stat_get(stat, SMB_STAT_WTIME);
         
-        _modificationTime = [self dateFromLDAPTimeStamp:_modificationTimestamp];
-        _creationTime = [self dateFromLDAPTimeStamp:_creationTimestamp];
+        //The dates and file path are generated when they're first accessed
+        _parentDirectoryFilePath = [path copy];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithName:(NSString *)name
+                    fileSize:(uint64_t)fileSize
+              allocationSize:(uint64_t)allocationSize
+                   directory:(BOOL)directory
+           creationTimestamp:(uint64_t)creationTimestamp
+             accessTimestamp:(uint64_t)accessTimestamp
+              writeTimestamp:(uint64_t)writeTimestamp
+       modificationTimestamp:(uint64_t)modificationTimestamp
+                     session:(TOSMBSession *)session
+     parentDirectoryFilePath:(NSString *)path
+{
+    if (name == nil)
+        return nil;
+    
+    if (self = [self init]) {
+        _name = [name copy];
+        _fileSize = fileSize;
+        _allocationSize = allocationSize;
+        _directory = directory;
+        _creationTimestamp = creationTimestamp;
+        _accessTimestamp = accessTimestamp;
+        _writeTimestamp = writeTimestamp;
+        _modificationTimestamp = modificationTimestamp;
+        _parentDirectoryFilePath = [path copy];
         
-        _filePath = [path stringByAppendingPathComponent:_name];
+        _session = session;
     }
     
     return self;
@@ -110,40 +158,60 @@
     return self;
 }
 
-//SO Answer by Dave DeLong - http://stackoverflow.com/a/11978614/599344
 - (NSDate *)dateFromLDAPTimeStamp:(uint64_t)timestamp
 {
-    NSDateComponents *base = [[NSDateComponents alloc] init];
-    [base setDay:1];
-    [base setMonth:1];
-    [base setYear:1601];
-    [base setEra:1]; // AD
-    
-    NSCalendar *gregorian = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
-    NSDate *baseDate = [gregorian dateFromComponents:base];
-    
-    NSTimeInterval newTimestamp = timestamp / 10000000.0f;
-    NSDate *finalDate = [baseDate dateByAddingTimeInterval:newTimestamp];
-    
-    return finalDate;
+    return TOSMBDateFromFileTime(timestamp);
+}
+
+//These values are only created the first time they're asked for, which may happen on several threads at once
+- (NSString *)filePath
+{
+    @synchronized (self) {
+        if (_filePath == nil)
+            _filePath = [self.parentDirectoryFilePath stringByAppendingPathComponent:self.name];
+        
+        return _filePath;
+    }
+}
+
+- (NSDate *)modificationTime
+{
+    @synchronized (self) {
+        if (_modificationTime == nil && self.isShareRoot == NO)
+            _modificationTime = [self dateFromLDAPTimeStamp:self.modificationTimestamp];
+        
+        return _modificationTime;
+    }
+}
+
+- (NSDate *)creationTime
+{
+    @synchronized (self) {
+        if (_creationTime == nil && self.isShareRoot == NO)
+            _creationTime = [self dateFromLDAPTimeStamp:self.creationTimestamp];
+        
+        return _creationTime;
+    }
 }
 
 - (NSDate *)accessTime
 {
-    if (_accessTime)
+    @synchronized (self) {
+        if (_accessTime == nil)
+            _accessTime = [self dateFromLDAPTimeStamp:self.accessTimestamp];
+        
         return _accessTime;
-    
-    _accessTime = [self dateFromLDAPTimeStamp:self.accessTimestamp];
-    return _accessTime;
+    }
 }
 
 - (NSDate *)writeTime
 {
-    if (_writeTime)
+    @synchronized (self) {
+        if (_writeTime == nil)
+            _writeTime = [self dateFromLDAPTimeStamp:self.writeTimestamp];
+        
         return _writeTime;
-    
-    _writeTime = [self dateFromLDAPTimeStamp:self.writeTimestamp];
-    return _writeTime;
+    }
 }
 
 #pragma mark - Debug -
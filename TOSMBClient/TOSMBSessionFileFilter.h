@@ -0,0 +1,56 @@
+//
+// TOSMBSessionFileFilter.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+/**
+ A set of conditions used to narrow down the results of a directory listing.
+ The name pattern is sent to the device, so non-matching entries are never transferred,
+ and the remaining conditions are checked against each entry as it's read, before any objects are created for it.
+ */
+@interface TOSMBSessionFileFilter : NSObject <NSCopying>
+
+/** A wildcard pattern matched against file names by the device, such as `*.mkv` or `IMG_*`. `*` and `?` are supported.
+ * Setting this to nil matches every file. Default: nil. */
+@property (nonatomic, copy) NSString *pattern;
+
+/** The smallest file size, in bytes, to include. Directories are not affected. Default: 0. */
+@property (nonatomic, assign) uint64_t minimumFileSize;
+
+/** The largest file size, in bytes, to include. Directories are not affected. Default: UINT64_MAX. */
+@property (nonatomic, assign) uint64_t maximumFileSize;
+
+/** When set, only files modified on or after this date are included. Default: nil. */
+@property (nonatomic, copy) NSDate *modifiedSinceDate;
+
+/** When YES, only directories are included. Default: NO. */
+@property (nonatomic, assign) BOOL directoriesOnly;
+
+/**
+ Creates a new filter matching file names against the given wildcard pattern.
+ 
+ @param pattern The wildcard pattern to match, such as `*.mkv`
+ @return A new filter object
+ */
++ (instancetype)filterWithPattern:(NSString *)pattern;
+
+@end
@@ -0,0 +1,96 @@
+//
+// TOSMBSessionFileFilter.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionFileFilterPrivate.h"
+#import "TOSMBSessionFilePrivate.h"
+
+@interface TOSMBSessionFileFilter ()
+
+/* The modified-since date, converted once so it can be compared directly against SMB_STAT_MTIME */
+@property (nonatomic, assign) uint64_t modifiedSinceTimestamp;
+
+@end
+
+@implementation TOSMBSessionFileFilter
+
++ (instancetype)filterWithPattern:(NSString *)pattern
+{
+    TOSMBSessionFileFilter *filter = [[TOSMBSessionFileFilter alloc] init];
+    filter.pattern = pattern;
+    return filter;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _maximumFileSize = UINT64_MAX;
+    }
+    
+    return self;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    TOSMBSessionFileFilter *filter = [[[self class] allocWithZone:zone] init];
+    filter.pattern = self.pattern;
+    filter.minimumFileSize = self.minimumFileSize;
+    filter.maximumFileSize = self.maximumFileSize;
+    filter.modifiedSinceDate = self.modifiedSinceDate;
+    filter.directoriesOnly = self.directoriesOnly;
+    return filter;
+}
+
+#pragma mark - Matching -
+- (BOOL)matchesStat:(smb_stat)stat
+{
+    return [self matchesFileSize:smb_stat_get(stat, SMB_STAT_SIZE)
+                       directory:(smb_stat_get(stat, SMB_STAT_ISDIR) != 0)
+           modificationTimestamp:smb_stat_get(stat, SMB_STAT_MTIME)];
+}
+
+- (BOOL)matchesFileSize:(uint64_t)fileSize directory:(BOOL)directory modificationTimestamp:(uint64_t)modificationTimestamp
+{
+    if (self.directoriesOnly && directory == NO)
+        return NO;
+    
+    if (directory == NO && (fileSize < self.minimumFileSize || fileSize > self.maximumFileSize))
+        return NO;
+    
+    if (self.modifiedSinceTimestamp > 0 && modificationTimestamp < self.modifiedSinceTimestamp)
+        return NO;
+    
+    return YES;
+}
+
+#pragma mark - Accessors -
+- (NSString *)searchPattern
+{
+    return self.pattern.length ? self.pattern : @"*";
+}
+
+- (void)setModifiedSinceDate:(NSDate *)modifiedSinceDate
+{
+    _modifiedSinceDate = [modifiedSinceDate copy];
+    _modifiedSinceTimestamp = TOSMBFileTimeFromDate(modifiedSinceDate);
+}
+
+@end
@@ -0,0 +1,42 @@
+//
+// TOSMBSessionFileFilterPrivate.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#ifndef TOSMBSessionFileFilterPrivate_h
+#define TOSMBSessionFileFilterPrivate_h
+
+#import "TOSMBSessionFileFilter.h"
+#import "smb_stat.h"
+
+@interface TOSMBSessionFileFilter ()
+
+/* The pattern appended to the directory path in the `smb_find` query. Always at least `*`. */
+@property (nonatomic, readonly) NSString *searchPattern;
+
+/* Checks the client-side conditions against the raw values of a stat entry */
+- (BOOL)matchesStat:(smb_stat)stat;
+
+/* Checks the client-side conditions against the values of an entry, with its modification time as a FILETIME value */
+- (BOOL)matchesFileSize:(uint64_t)fileSize directory:(BOOL)directory modificationTimestamp:(uint64_t)modificationTimestamp;
+
+@end
+
+#endif /* TOSMBSessionFileFilterPrivate_h */
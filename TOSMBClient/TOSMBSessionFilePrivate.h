@@ -23,8 +23,18 @@
 #import "TOSMBSessionFile.h"
 #import "smb_stat.h"
 
+/** Converts a Windows FILETIME value (100-nanosecond intervals since 1601) to an NSDate, and back again. */
+extern NSDate *TOSMBDateFromFileTime(uint64_t fileTime);
+extern uint64_t TOSMBFileTimeFromDate(NSDate *date);
+
 @interface TOSMBSessionFile ()
 
+/* The raw FILETIME values of each date, which are only converted to NSDate objects when accessed */
+@property (nonatomic, assign) uint64_t modificationTimestamp;
+@property (nonatomic, assign) uint64_t creationTimestamp;
+@property (nonatomic, assign) uint64_t accessTimestamp;
+@property (nonatomic, assign) uint64_t writeTimestamp;
+
 /**
  * Init a new instance representing a file or folder inside a network share
  *
@@ -34,6 +44,31 @@
  */
 - (instancetype)initWithStat:(smb_stat)stat session:(TOSMBSession *)session parentDirectoryFilePath:(NSString *)path;
 
+/**
+ * Init a new instance from values that have already been read out of a stat entry
+ *
+ * @param name The name of the file
+ * @param fileSize The size of the file, in bytes
+ * @param allocationSize The allocation size of the file, in bytes
+ * @param directory Whether the item is a directory
+ * @param creationTimestamp The creation time, as a FILETIME value
+ * @param accessTimestamp The last access time, as a FILETIME value
+ * @param writeTimestamp The last write time, as a FILETIME value
+ * @param modificationTimestamp The last modification time, as a FILETIME value
+ * @param session The session in which this item belongs to
+ * @param path The absolute file path to this file's parent directory. Used to generate this file's own file path.
+ */
+- (instancetype)initWithName:(NSString *)name
+                    fileSize:(uint64_t)fileSize
+              allocationSize:(uint64_t)allocationSize
+                   directory:(BOOL)directory
+           creationTimestamp:(uint64_t)creationTimestamp
+             accessTimestamp:(uint64_t)accessTimestamp
+              writeTimestamp:(uint64_t)writeTimestamp
+       modificationTimestamp:(uint64_t)modificationTimestamp
+                     session:(TOSMBSession *)session
+     parentDirectoryFilePath:(NSString *)path;
+
 /**
  * Init a new instance representing the share itself, which in the case of libSMD, is simply another directory
  *
@@ -0,0 +1,125 @@
+//
+// TOSMBSessionFileReader.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+@class TOSMBSession;
+@class TOSMBSessionFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Reads arbitrary ranges of a file on an SMB device without downloading it, for things like
+ seeking in media files or reading the central directory of a ZIP archive.
+ 
+ The reader borrows a logged-in connection from its session and keeps the file open on it
+ until it is closed, so consecutive reads don't pay for a new handshake or open request.
+ Data is fetched and cached in fixed-size blocks. When reads are sequential, the blocks
+ following the last read are fetched in the background before they are asked for.
+ 
+ All reads are performed one at a time, in the order they were requested.
+ */
+@interface TOSMBSessionFileReader : NSObject
+
+/** The session the file is being read from. */
+@property (nonatomic, readonly, weak) TOSMBSession *session;
+
+/** The path of the file being read. */
+@property (nonatomic, readonly) NSString *filePath;
+
+/** The file's information, once the reader has been opened. */
+@property (nonatomic, readonly, nullable) TOSMBSessionFile *file;
+
+/** The size of the file, once the reader has been opened. */
+@property (nonatomic, readonly) uint64_t fileSize;
+
+/** Whether the file is currently open. */
+@property (readonly, getter=isOpen) BOOL open;
+
+/** The number of bytes fetched and cached at a time. Changing it empties the cache. Default: 65536. */
+@property (nonatomic, assign) NSUInteger blockSize;
+
+/** The maximum number of blocks kept in memory. The least recently used blocks are discarded first. Default: 64. */
+@property (nonatomic, assign) NSUInteger maximumCachedBlockCount;
+
+/** The number of blocks fetched ahead of sequential reads. 0 disables reading ahead. Default: 4. */
+@property (nonatomic, assign) NSUInteger readAheadBlockCount;
+
+/** The number of blocks that were found in the cache when they were needed by a read. */
+@property (readonly) NSUInteger cacheHitCount;
+
+/** The number of blocks that had to be fetched from the device when they were needed by a read. */
+@property (readonly) NSUInteger cacheMissCount;
+
+/** The proportion of blocks that were served from the cache, between 0 and 1. */
+@property (readonly) double cacheHitRatio;
+
+/** The number of bytes returned to callers. */
+@property (readonly) uint64_t bytesRead;
+
+/** The number of bytes actually received from the device, including blocks fetched ahead. */
+@property (readonly) uint64_t bytesReceived;
+
+/**
+ Creates a new reader. The file isn't opened until `openWithError:` or the first read.
+ 
+ @param session The session of the device holding the file
+ @param path The path of the file to read
+ */
+- (instancetype)initWithSession:(TOSMBSession *)session filePath:(NSString *)path;
+
+/**
+ Connects to the device and opens the file. Reading implicitly opens the file too,
+ but opening it ahead of time makes the first read faster.
+ 
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return YES if the file is open.
+ */
+- (BOOL)openWithError:(NSError * _Nullable *)error;
+
+/**
+ Synchronously reads a range of the file. This will block the current thread, so must not be called on the main thread.
+ 
+ @param offset The offset in the file to start reading from
+ @param length The number of bytes to read
+ @param error A pointer to an NSError object that will be non-nil if an error occurs.
+ @return The requested data, which is shorter than `length` if it reaches the end of the file, or nil if an error occurred.
+ */
+- (nullable NSData *)readDataAtOffset:(uint64_t)offset length:(NSUInteger)length error:(NSError * _Nullable *)error;
+
+/**
+ Asynchronously reads a range of the file.
+ 
+ @param offset The offset in the file to start reading from
+ @param length The number of bytes to read
+ @param completionHandler A block called on the session's delegate queue with the data, or an error if one occurred.
+ */
+- (void)readDataAtOffset:(uint64_t)offset
+                  length:(NSUInteger)length
+       completionHandler:(void (^)(NSData * _Nullable data, NSError * _Nullable error))completionHandler;
+
+/** Closes the file, returns the connection to the session and empties the cache. The reader may be opened again afterwards. */
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,418 @@
+//
+// TOSMBSessionFileReader.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionFileReader.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBSessionFile.h"
+#import "TOSMBSessionFilePrivate.h"
+#import "TOSMBConstants.h"
+#import "smb_file.h"
+
+@interface TOSMBSessionFileReader ()
+
+@property (nonatomic, weak, readwrite) TOSMBSession *session;
+@property (nonatomic, copy, readwrite) NSString *filePath;
+@property (nonatomic, strong, readwrite) TOSMBSessionFile *file;
+@property (nonatomic, assign, readwrite) uint64_t fileSize;
+@property (assign, readwrite, getter=isOpen) BOOL open;
+
+@property (assign, readwrite) NSUInteger cacheHitCount;
+@property (assign, readwrite) NSUInteger cacheMissCount;
+@property (assign, readwrite) uint64_t bytesRead;
+@property (assign, readwrite) uint64_t bytesReceived;
+
+/* All file access happens one request at a time on this queue */
+@property (nonatomic, strong) dispatch_queue_t readQueue;
+
+/* The open file. Only accessed on the read queue. */
+@property (nonatomic, strong) TOSMBConnection *connection;
+@property (nonatomic, assign) smb_tid treeID;
+@property (nonatomic, assign) smb_fd fileID;
+
+/* Cached blocks, keyed by their index in the file, with the most recently used last. Only accessed on the read queue. */
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSData *> *cachedBlocks;
+@property (nonatomic, strong) NSMutableOrderedSet<NSNumber *> *recentBlocks;
+@property (nonatomic, assign) NSUInteger cachedBlockSize;
+
+/* Read-ahead state. Only accessed on the read queue. */
+@property (nonatomic, assign) uint64_t nextSequentialOffset;
+@property (nonatomic, assign) uint64_t lastReadBlockIndex;
+@property (nonatomic, strong) NSMutableIndexSet *pendingReadAheadBlocks;
+
+- (NSError *)openFile;
+- (void)closeFile;
+- (NSData *)performReadAtOffset:(uint64_t)offset length:(NSUInteger)length error:(NSError **)error;
+- (NSData *)blockAtIndex:(uint64_t)index error:(NSError **)error;
+- (NSData *)fetchBlockAtIndex:(uint64_t)index error:(NSError **)error;
+- (void)readAheadAfterBlockAtIndex:(uint64_t)index;
+
+@end
+
+@implementation TOSMBSessionFileReader
+
+- (instancetype)initWithSession:(TOSMBSession *)session filePath:(NSString *)path
+{
+    if (self = [super init]) {
+        _session = session;
+        _filePath = [path copy];
+        _blockSize = 65536;
+        _maximumCachedBlockCount = 64;
+        _readAheadBlockCount = 4;
+        _readQueue = dispatch_queue_create("com.timoliver.tosmbclient.filereader", DISPATCH_QUEUE_SERIAL);
+        _cachedBlocks = [NSMutableDictionary dictionary];
+        _recentBlocks = [NSMutableOrderedSet orderedSet];
+        _pendingReadAheadBlocks = [NSMutableIndexSet indexSet];
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    //Any pending work retains the reader, so nothing can be using the file by now
+    [self closeFile];
+}
+
+#pragma mark - Public Methods -
+- (BOOL)openWithError:(NSError **)error
+{
+    __block NSError *openError = nil;
+    dispatch_sync(self.readQueue, ^{
+        openError = [self openFile];
+    });
+    
+    if (error)
+        *error = openError;
+    
+    return (openError == nil);
+}
+
+- (NSData *)readDataAtOffset:(uint64_t)offset length:(NSUInteger)length error:(NSError **)error
+{
+    __block NSData *data = nil;
+    __block NSError *readError = nil;
+    dispatch_sync(self.readQueue, ^{
+        data = [self performReadAtOffset:offset length:length error:&readError];
+    });
+    
+    if (error)
+        *error = readError;
+    
+    return data;
+}
+
+- (void)readDataAtOffset:(uint64_t)offset length:(NSUInteger)length completionHandler:(void (^)(NSData *, NSError *))completionHandler
+{
+    dispatch_async(self.readQueue, ^{
+        NSError *error = nil;
+        NSData *data = [self performReadAtOffset:offset length:length error:&error];
+        if (completionHandler == nil)
+            return;
+        
+        NSOperationQueue *delegateQueue = self.session.delegateQueue ?: [NSOperationQueue mainQueue];
+        [delegateQueue addOperationWithBlock:^{ completionHandler(data, error); }];
+    });
+}
+
+- (void)close
+{
+    //Closing the file is a network request, so don't make the caller wait for it
+    dispatch_async(self.readQueue, ^{
+        [self closeFile];
+        [self.cachedBlocks removeAllObjects];
+        [self.recentBlocks removeAllObjects];
+        self.nextSequentialOffset = 0;
+    });
+}
+
+- (double)cacheHitRatio
+{
+    NSUInteger hitCount = self.cacheHitCount;
+    NSUInteger totalCount = hitCount + self.cacheMissCount;
+    if (totalCount == 0)
+        return 0.0;
+    
+    return (double)hitCount / (double)totalCount;
+}
+
+#pragma mark - Opening and Closing -
+- (NSError *)openFile
+{
+    if (self.fileID)
+        return nil;
+    
+    TOSMBSession *session = self.session;
+    if (session == nil)
+        return errorForErrorCode(TOSMBSessionErrorCodeUnableToConnect);
+    
+    //Borrow a logged-in connection from the session. It's kept until the reader is closed.
+    NSError *error = nil;
+    TOSMBConnection *connection = [session dequeueConnectionWithError:&error];
+    if (connection == nil)
+        return error;
+    
+    NSString *shareName = [session shareNameFromPath:self.filePath];
+    NSString *formattedPath = [session filePathExcludingSharePathFromPath:self.filePath];
+    formattedPath = [NSString stringWithFormat:@"\\%@",formattedPath];
+    formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+    const char *fileCString = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    smb_tid treeID = 0;
+    __block smb_stat fileStat = NULL;
+    error = [connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        fileStat = smb_fstat(connection.session, shareTreeID, fileCString);
+        return (fileStat != NULL);
+    }];
+    if (error) {
+        [session enqueueConnection:connection];
+        return error;
+    }
+    
+    if (fileStat == NULL) {
+        [session enqueueConnection:connection];
+        return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+    }
+    
+    TOSMBSessionFile *file = [[TOSMBSessionFile alloc] initWithStat:fileStat session:session parentDirectoryFilePath:[self.filePath stringByDeletingLastPathComponent]];
+    smb_stat_destroy(fileStat);
+    
+    if (file.directory) {
+        [session enqueueConnection:connection];
+        return errorForErrorCode(TOSMBSessionErrorCodeDirectoryDownloaded);
+    }
+    
+    smb_fd fileID = 0;
+    smb_fopen(connection.session, treeID, fileCString, SMB_MOD_RO, &fileID);
+    if (!fileID) {
+        [session enqueueConnection:connection];
+        return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+    }
+    
+    //If the file was changed since it was last open, anything cached is out of date
+    if (self.file && (self.file.fileSize != file.fileSize || self.file.modificationTimestamp != file.modificationTimestamp)) {
+        [self.cachedBlocks removeAllObjects];
+        [self.recentBlocks removeAllObjects];
+    }
+    
+    self.connection = connection;
+    self.treeID = treeID;
+    self.fileID = fileID;
+    self.file = file;
+    self.fileSize = file.fileSize;
+    self.open = YES;
+    
+    return nil;
+}
+
+- (void)closeFile
+{
+    if (self.connection == nil)
+        return;
+    
+    if (self.fileID && self.connection.isInvalid == NO)
+        smb_fclose(self.connection.session, self.fileID);
+    
+    [self.session enqueueConnection:self.connection];
+    
+    self.connection = nil;
+    self.treeID = 0;
+    self.fileID = 0;
+    self.open = NO;
+}
+
+#pragma mark - Reading -
+- (NSData *)performReadAtOffset:(uint64_t)offset length:(NSUInteger)length error:(NSError **)error
+{
+    NSError *openError = [self openFile];
+    if (openError) {
+        if (error)
+            *error = openError;
+        
+        return nil;
+    }
+    
+    //A new block size invalidates every block already cached
+    NSUInteger blockSize = MAX(self.blockSize, (NSUInteger)512);
+    if (blockSize != self.cachedBlockSize) {
+        [self.cachedBlocks removeAllObjects];
+        [self.recentBlocks removeAllObjects];
+        self.cachedBlockSize = blockSize;
+    }
+    
+    if (length == 0 || offset >= self.fileSize)
+        return [NSData data];
+    
+    length = (NSUInteger)MIN((uint64_t)length, self.fileSize - offset);
+    
+    uint64_t firstBlockIndex = offset / blockSize;
+    uint64_t lastBlockIndex = (offset + length - 1) / blockSize;
+    
+    NSMutableData *data = [NSMutableData dataWithCapacity:length];
+    for (uint64_t index = firstBlockIndex; index <= lastBlockIndex; index++) {
+        NSData *block = [self blockAtIndex:index error:error];
+        if (block == nil)
+            return nil;
+        
+        uint64_t blockOffset = index * blockSize;
+        uint64_t start = MAX(offset, blockOffset) - blockOffset;
+        uint64_t end = MIN(offset + length, blockOffset + block.length) - blockOffset;
+        if (end <= start)
+            break;
+        
+        [data appendBytes:(const char *)block.bytes + start length:(NSUInteger)(end - start)];
+        
+        //The file turned out to be shorter than it was when it was opened
+        if (block.length < blockSize)
+            break;
+    }
+    
+    self.bytesRead += data.length;
+    
+    //Only reads that carry on from where the last one finished are followed by reading ahead
+    BOOL sequential = (offset == self.nextSequentialOffset);
+    self.nextSequentialOffset = offset + data.length;
+    self.lastReadBlockIndex = lastBlockIndex;
+    if (sequential)
+        [self readAheadAfterBlockAtIndex:lastBlockIndex];
+    
+    return data;
+}
+
+- (NSData *)blockAtIndex:(uint64_t)index error:(NSError **)error
+{
+    NSNumber *key = @(index);
+    NSData *block = self.cachedBlocks[key];
+    if (block) {
+        self.cacheHitCount++;
+        [self.recentBlocks removeObject:key];
+        [self.recentBlocks addObject:key];
+        return block;
+    }
+    
+    self.cacheMissCount++;
+    return [self fetchBlockAtIndex:index error:error];
+}
+
+- (NSData *)fetchBlockAtIndex:(uint64_t)index error:(NSError **)error
+{
+    uint64_t blockSize = self.cachedBlockSize;
+    uint64_t blockOffset = index * blockSize;
+    NSUInteger length = (NSUInteger)MIN(blockSize, self.fileSize - blockOffset);
+    NSMutableData *block = [NSMutableData dataWithLength:length];
+    TOSMBChunkSizer *chunkSizer = self.session.readChunkSizer;
+    
+    //If the connection has dropped since the last read, reopen the file on a new one and try once more
+    NSUInteger bytesReceived = 0;
+    for (NSInteger attempt = 0; attempt < 2; attempt++) {
+        NSError *openError = [self openFile];
+        if (openError) {
+            if (error)
+                *error = openError;
+            
+            return nil;
+        }
+        
+        smb_session *session = self.connection.session;
+        smb_fseek(session, self.fileID, (off_t)blockOffset, SMB_SEEK_SET);
+        
+        ssize_t bytesRead = 0;
+        bytesReceived = 0;
+        while (bytesReceived < length) {
+            size_t chunkSize = MIN(chunkSizer.chunkSize, length - bytesReceived);
+            CFAbsoluteTime readStartTime = CFAbsoluteTimeGetCurrent();
+            bytesRead = smb_fread(session, self.fileID, (char *)block.mutableBytes + bytesReceived, chunkSize);
+            if (bytesRead <= 0)
+                break;
+            
+            bytesReceived += bytesRead;
+            [chunkSizer recordTransferOfBytes:(size_t)bytesRead
+                               requestedBytes:chunkSize
+                                     duration:CFAbsoluteTimeGetCurrent() - readStartTime
+                                    endOfFile:(blockOffset + bytesReceived >= self.fileSize)];
+        }
+        
+        self.bytesReceived += bytesReceived;
+        
+        if (bytesRead >= 0)
+            break;
+        
+        self.connection.invalid = YES;
+        [self closeFile];
+        
+        if (attempt > 0) {
+            if (error)
+                *error = errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed);
+            
+            return nil;
+        }
+    }
+    
+    block.length = bytesReceived;
+    
+    //Cache the block, throwing out the least recently used ones if there are too many
+    NSNumber *key = @(index);
+    self.cachedBlocks[key] = block;
+    [self.recentBlocks removeObject:key];
+    [self.recentBlocks addObject:key];
+    
+    NSUInteger maximumCount = MAX(self.maximumCachedBlockCount, (NSUInteger)1);
+    while (self.recentBlocks.count > maximumCount) {
+        NSNumber *oldestKey = self.recentBlocks.firstObject;
+        [self.cachedBlocks removeObjectForKey:oldestKey];
+        [self.recentBlocks removeObjectAtIndex:0];
+    }
+    
+    return block;
+}
+
+- (void)readAheadAfterBlockAtIndex:(uint64_t)index
+{
+    NSUInteger readAheadCount = MIN(self.readAheadBlockCount, MAX(self.maximumCachedBlockCount, (NSUInteger)1) - 1);
+    uint64_t blockSize = self.cachedBlockSize;
+    
+    //Each block is fetched as a separate piece of work, so a read arriving in the meantime
+    //only has to wait for the block currently being fetched
+    for (NSUInteger i = 1; i <= readAheadCount; i++) {
+        uint64_t blockIndex = index + i;
+        if (blockIndex * blockSize >= self.fileSize)
+            break;
+        
+        if (self.cachedBlocks[@(blockIndex)] || [self.pendingReadAheadBlocks containsIndex:(NSUInteger)blockIndex])
+            continue;
+        
+        [self.pendingReadAheadBlocks addIndex:(NSUInteger)blockIndex];
+        dispatch_async(self.readQueue, ^{
+            [self.pendingReadAheadBlocks removeIndex:(NSUInteger)blockIndex];
+            
+            //Skip blocks that reads have since moved away from, or that a read already fetched
+            uint64_t lastIndex = self.lastReadBlockIndex;
+            if (self.open == NO || blockSize != self.cachedBlockSize || self.cachedBlocks[@(blockIndex)] ||
+                blockIndex <= lastIndex || blockIndex > lastIndex + readAheadCount) {
+                return;
+            }
+            
+            [self fetchBlockAtIndex:blockIndex error:nil];
+        });
+    }
+}
+
+@end
@@ -24,11 +24,57 @@
 #define TOSMBSessionPrivate_h
 
 #import "TOSMBSession.h"
+#import "TOSMBConnection.h"
+#import "TOSMBSessionFileFilter.h"
+#import "TOSMBBufferPool.h"
+#import "TOSMBChunkSizer.h"
+#import "TOSMBProgressCoalescer.h"
 #import "smb_session.h"
+#import "smb_stat.h"
 
 @interface TOSMBSession ()
 
 - (NSError *)attemptConnectionWithSessionPointer:(smb_session *)session;
+
+/* I/O buffers shared by all of this session's tasks */
+@property (nonatomic, readonly) TOSMBBufferPool *bufferPool;
+
+/* Choose the size of each smb_fread and smb_fwrite call made by this session's tasks */
+@property (nonatomic, readonly) TOSMBChunkSizer *readChunkSizer;
+@property (nonatomic, readonly) TOSMBChunkSizer *writeChunkSizer;
+
+/* Gathers up the progress updates of this session's tasks */
+@property (nonatomic, readonly) TOSMBProgressCoalescer *progressCoalescer;
+
+/* Asynchronously runs a callback on the delegate queue */
+- (void)performDelegateBlock:(void (^)(void))block;
+
+/* Connection pool used by tasks */
+- (TOSMBConnection *)dequeueConnectionWithError:(NSError **)error;
+- (void)enqueueConnection:(TOSMBConnection *)connection;
+
+/* Calls the block for every visible entry of a directory, using the supplied (Already logged in) connection */
+- (NSError *)enumerateStatsOfDirectoryAtFilePath:(NSString *)path
+                                      connection:(TOSMBConnection *)connection
+                                      usingBlock:(void (^)(smb_stat stat, BOOL *stop))block;
+
+/* As above, but only asks the device for entries matching the filter's pattern, and skips entries failing its other conditions */
+- (NSError *)enumerateStatsOfDirectoryAtFilePath:(NSString *)path
+                                          filter:(TOSMBSessionFileFilter *)filter
+                                      connection:(TOSMBConnection *)connection
+                                      usingBlock:(void (^)(smb_stat stat, BOOL *stop))block;
+
+/* Reads the whole of a file, using the supplied (Already logged in) connection. If a buffer is supplied, the file is read
+   into it, and the returned data wraps it. Otherwise, new data is allocated to the size of the file. */
+- (NSData *)readContentsOfFileAtPath:(NSString *)path
+                          connection:(TOSMBConnection *)connection
+                              buffer:(void *)buffer
+                              length:(NSUInteger)length
+                               error:(NSError **)error;
+
+/* Creates a directory, using the supplied (Already logged in) connection. Succeeds if the directory already exists. */
+- (NSError *)createDirectoryAtPath:(NSString *)path connection:(TOSMBConnection *)connection;
+
 - (NSString *)shareNameFromPath:(NSString *)path;
 - (NSString *)filePathExcludingSharePathFromPath:(NSString *)path;
 
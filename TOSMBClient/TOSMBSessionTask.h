@@ -55,6 +55,9 @@
  
  Downloads are resumed if there is already data for this file on disk,
  and the modification date of that file matches the one on the network device.
+ 
+ Uploads are resumed from the end of the file on the network device, if the
+ end of that file matches the data being uploaded.
  */
 - (void)resume;
 
@@ -21,6 +21,8 @@
 // -------------------------------------------------------------------------------
 
 #import "TOSMBSessionTaskPrivate.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBProgressCoalescer.h"
 
 @implementation TOSMBSessionTask
 
@@ -60,22 +62,24 @@
             self.backgroundTaskIdentifier = 0;
         }
         
-        if (self.taskOperation && treeID) {
-            smb_tree_disconnect(self.smbSession, treeID);
-        }
-        
         if (self.smbSession && fileID) {
             smb_fclose(self.smbSession, fileID);
         }
-
         
-        if (self.smbSession) {
-            smb_session_destroy(self.smbSession);
-            self.smbSession = nil;
+        //The share tree is left connected, as it's cached by the connection for the next task to reuse.
+        //Hand the connection back to the session so the next task can skip the handshake
+        if (self.connection) {
+            [self.session enqueueConnection:self.connection];
+            self.connection = nil;
         }
     };
 }
 
+- (smb_session *)smbSession
+{
+    return self.connection.session;
+}
+
 #pragma mark - Task Methods
 
 - (TOSMBSessionFile *)requestFileForItemAtPath:(NSString *)filePath inTree:(smb_tid)treeID
@@ -140,16 +144,82 @@
     self.state = TOSMBSessionTaskStateFailed;
 }
 
+#pragma mark - Workers -
+
+- (void)performWithWorkerCount:(NSUInteger)workerCount usingBlock:(void (^)(NSUInteger worker))block
+{
+    //Workers spend most of their time blocked on the network, so each one gets its own thread on a dedicated
+    //queue, rather than being limited to the number of CPU cores like dispatch_apply() would.
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t workerQueue = dispatch_queue_create("com.timoliver.tosmbclient.task.workers", DISPATCH_QUEUE_CONCURRENT);
+    for (NSUInteger i = 0; i < workerCount; i++) {
+        dispatch_group_async(group, workerQueue, ^{
+            block(i);
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+#pragma mark - Progress -
+
+- (uint64_t)progressBytesCompleted
+{
+    return 0;
+}
+
+- (uint64_t)progressBytesExpected
+{
+    return 0;
+}
+
+- (void)didUpdateProgress
+{
+    TOSMBSession *session = self.session;
+    uint64_t completed = self.progressBytesCompleted;
+    uint64_t expected = self.progressBytesExpected;
+    BOOL final = (expected > 0 && completed >= expected);
+    
+    //Small amounts of progress are held back until enough has built up (Apart from the final update)
+    uint64_t delivered = self.progressBytesDelivered;
+    if (final == NO && completed > delivered && completed - delivered < session.progressUpdateByteDelta)
+        return;
+    
+    [session.progressCoalescer addTask:self final:final];
+}
+
+- (void)deliverProgress
+{
+    uint64_t completed = self.progressBytesCompleted;
+    uint64_t delivered = self.progressBytesDelivered;
+    self.progressBytesDelivered = completed;
+    
+    [self deliverProgressWithBytes:(completed > delivered ? completed - delivered : 0)
+                        totalBytes:completed
+                totalBytesExpected:self.progressBytesExpected];
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected
+{
+    if (self.progressHandler)
+        self.progressHandler(totalBytes, totalBytesExpected);
+}
+
 #pragma mark - Feedback Methods -
 
+- (void)performDelegateBlock:(void (^)(void))block
+{
+    NSOperationQueue *delegateQueue = self.session.delegateQueue ?: [NSOperationQueue mainQueue];
+    [delegateQueue addOperationWithBlock:block];
+}
+
 - (void)didFailWithError:(NSError *)error
 {
-    dispatch_sync(dispatch_get_main_queue(), ^{
+    [self performDelegateBlock:^{
         if (self.delegate && [self.delegate respondsToSelector:@selector(task:didCompleteWithError:)])
             [self.delegate task:self didCompleteWithError:error];
         if (self.failHandler)
             self.failHandler(error);
-    });
+    }];
 }
 
 @end
@@ -28,6 +28,7 @@
 #import "TOSMBSessionTask.h"
 #import "TOSMBSession.h"
 #import "TOSMBSessionFilePrivate.h"
+#import "TOSMBConnection.h"
 #import "smb_defs.h"
 #import "smb_file.h"
 #import "smb_session.h"
@@ -47,7 +48,8 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign) TOSMBSessionTaskState state;
 @property (nonatomic, assign) UIBackgroundTaskIdentifier backgroundTaskIdentifier;
 
-@property (nonatomic, assign, nullable) smb_session *smbSession;
+@property (nonatomic, strong, nullable) TOSMBConnection *connection; /* Borrowed from the session's connection pool */
+@property (nonatomic, readonly, nullable) smb_session *smbSession;
 @property (nonatomic, strong, null_resettable) NSBlockOperation *taskOperation;
 @property (nonatomic, readonly) void (^cleanupBlock)(smb_tid treeID, smb_fd fileID);
 
@@ -63,6 +65,21 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)fail;
 - (void)didFailWithError:(NSError *)error;
 
+/* Asynchronously runs a callback on the session's delegate queue (Or the main queue, if the session has gone away) */
+- (void)performDelegateBlock:(void (^)(void))block;
+
+/* Runs the block once for each worker concurrently, and returns once all of them have finished */
+- (void)performWithWorkerCount:(NSUInteger)workerCount usingBlock:(void (^)(NSUInteger worker))block;
+
+/* Progress. Updates are reported from any thread, and are coalesced by the session before being delivered on its delegate queue. */
+@property (nonatomic, readonly) uint64_t progressBytesCompleted;
+@property (nonatomic, readonly) uint64_t progressBytesExpected;
+@property (assign) uint64_t progressBytesDelivered; /* The completed byte count as of the last delivered update */
+
+- (void)didUpdateProgress;
+- (void)deliverProgress;
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected;
+
 @end
 
 NS_ASSUME_NONNULL_END
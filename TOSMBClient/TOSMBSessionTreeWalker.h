@@ -0,0 +1,98 @@
+//
+// TOSMBSessionTreeWalker.h
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+@class TOSMBSession;
+@class TOSMBSessionFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Recursively walks a directory tree on an SMB device, listing several directories at once
+ over independent, logged-in connections.
+ 
+ Each connection has its own queue of directories to list. Newly discovered subdirectories are added
+ to the queue of the connection that found them, and a connection that runs out of work takes
+ the oldest pending directory from another connection's queue, which keeps all of the connections busy
+ on trees of any shape.
+ */
+@interface TOSMBSessionTreeWalker : NSObject
+
+/** The session that this walker is listing the contents of. */
+@property (nonatomic, readonly, weak) TOSMBSession *session;
+
+/** The path of the directory the walk starts from. Supplying "/" walks every share. */
+@property (nonatomic, readonly) NSString *rootPath;
+
+/** The number of connections used to list directories concurrently. Default: 4. */
+@property (nonatomic, assign) NSUInteger maximumConnectionCount;
+
+/** The number of directory levels below `rootPath` to descend into. 0 lists only the contents
+ * of `rootPath` itself. Default: NSUIntegerMax (Unlimited). */
+@property (nonatomic, assign) NSUInteger maximumDepth;
+
+/** Decides whether a file or directory is delivered to `filesHandler`. nil includes everything.
+ * Called on a background thread, possibly from several threads at once. */
+@property (nonatomic, copy, nullable) BOOL (^includeHandler)(TOSMBSessionFile *file);
+
+/** Decides whether the walk descends into a directory. nil descends into every directory.
+ * Called on a background thread, possibly from several threads at once. */
+@property (nonatomic, copy, nullable) BOOL (^descendHandler)(TOSMBSessionFile *directory);
+
+/** Called with the included entries of each directory as soon as that directory has been listed.
+ * Calls are made one at a time on a private serial queue. */
+@property (nonatomic, copy, nullable) void (^filesHandler)(NSArray<TOSMBSessionFile *> *files);
+
+/** Called on the session's delegate queue once the walk has finished or was cancelled. The error is that of
+ * the first directory that couldn't be listed, if any. */
+@property (nonatomic, copy, nullable) void (^completionHandler)(NSError * _Nullable error);
+
+/** Whether the walk is in progress. */
+@property (readonly, getter=isRunning) BOOL running;
+
+/** Whether the walk was cancelled. */
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+/** The number of directories listed so far. */
+@property (readonly) NSUInteger directoryCount;
+
+/** The number of entries delivered to `filesHandler` so far. */
+@property (readonly) NSUInteger fileCount;
+
+/**
+ Creates a new walker. Configure it, and then call `start`.
+ 
+ @param session The session of the device to walk
+ @param path The path of the directory the walk starts from
+ */
+- (instancetype)initWithSession:(TOSMBSession *)session rootPath:(NSString *)path;
+
+/** Starts walking the tree. The walker retains itself until it has finished. */
+- (void)start;
+
+/** Stops the walk. Directories currently being listed are abandoned. */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
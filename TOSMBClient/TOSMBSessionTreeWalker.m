@@ -0,0 +1,299 @@
+//
+// TOSMBSessionTreeWalker.m
+// Copyright 2015-2017 Timothy Oliver
+//
+// This file is dual-licensed under both the MIT License, and the LGPL v2.1 License.
+//
+// -------------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+// -------------------------------------------------------------------------------
+
+#import "TOSMBSessionTreeWalker.h"
+#import "TOSMBSessionPrivate.h"
+#import "TOSMBSessionFile.h"
+#import "TOSMBSessionFilePrivate.h"
+
+// -------------------------------------------------------------------------
+
+/* A directory waiting to be listed */
+@interface TOSMBSessionTreeWalkerItem : NSObject
+
+@property (nonatomic, copy) NSString *path;
+@property (nonatomic, assign) NSUInteger depth;
+
+@end
+
+@implementation TOSMBSessionTreeWalkerItem
+@end
+
+// -------------------------------------------------------------------------
+
+@interface TOSMBSessionTreeWalker ()
+
+@property (nonatomic, weak, readwrite) TOSMBSession *session;
+@property (nonatomic, copy, readwrite) NSString *rootPath;
+
+@property (assign, readwrite, getter=isRunning) BOOL running;
+@property (assign, readwrite, getter=isCancelled) BOOL cancelled;
+@property (assign, readwrite) NSUInteger directoryCount;
+@property (assign, readwrite) NSUInteger fileCount;
+
+/* Guards the work queues, the pending count and the statistics, and wakes idle workers */
+@property (nonatomic, strong) NSCondition *workCondition;
+
+/* One queue of directories per worker connection */
+@property (nonatomic, strong) NSArray<NSMutableArray<TOSMBSessionTreeWalkerItem *> *> *workQueues;
+
+/* The number of directories that are either queued, or being listed */
+@property (nonatomic, assign) NSUInteger pendingDirectoryCount;
+
+@property (nonatomic, strong) NSError *firstError;
+
+/* Results are delivered serially, with a limit on how many batches may be waiting */
+@property (nonatomic, strong) dispatch_queue_t filesQueue;
+@property (nonatomic, strong) dispatch_semaphore_t pendingBatches;
+
+- (void)walkWithWorkerCount:(NSUInteger)workerCount;
+- (void)runWorkerAtIndex:(NSUInteger)index;
+- (TOSMBSessionTreeWalkerItem *)nextItemForWorkerAtIndex:(NSUInteger)index;
+- (void)listDirectoryForItem:(TOSMBSessionTreeWalkerItem *)item workerIndex:(NSUInteger)index connection:(TOSMBConnection *)connection;
+- (void)recordError:(NSError *)error;
+
+@end
+
+@implementation TOSMBSessionTreeWalker
+
+- (instancetype)initWithSession:(TOSMBSession *)session rootPath:(NSString *)path
+{
+    if (self = [super init]) {
+        _session = session;
+        _rootPath = path.length ? [path copy] : @"/";
+        _maximumConnectionCount = 4;
+        _maximumDepth = NSUIntegerMax;
+        _workCondition = [[NSCondition alloc] init];
+        _filesQueue = dispatch_queue_create("com.timoliver.tosmbclient.treewalker.files", DISPATCH_QUEUE_SERIAL);
+    }
+    
+    return self;
+}
+
+#pragma mark - Public Control Methods -
+- (void)start
+{
+    if (self.running)
+        return;
+    
+    self.running = YES;
+    self.cancelled = NO;
+    self.directoryCount = 0;
+    self.fileCount = 0;
+    self.firstError = nil;
+    
+    NSUInteger workerCount = MAX(1, self.maximumConnectionCount);
+    self.pendingBatches = dispatch_semaphore_create(workerCount * 4);
+    
+    //The block retains the walker until the walk has completed
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self walkWithWorkerCount:workerCount];
+    });
+}
+
+- (void)cancel
+{
+    [self.workCondition lock];
+    self.cancelled = YES;
+    [self.workCondition broadcast];
+    [self.workCondition unlock];
+}
+
+#pragma mark - Walking -
+- (void)walkWithWorkerCount:(NSUInteger)workerCount
+{
+    //Work out the directories to start from. Walking the root of the device starts from every share.
+    NSArray<NSString *> *startPaths = @[self.rootPath];
+    if ([self.rootPath isEqualToString:@"/"]) {
+        NSError *error = nil;
+        NSArray *shares = [self.session requestContentsOfDirectoryAtFilePath:@"/" error:&error];
+        [self recordError:error];
+        startPaths = [shares valueForKey:@"filePath"] ?: @[];
+    }
+    
+    NSMutableArray *workQueues = [NSMutableArray arrayWithCapacity:workerCount];
+    for (NSUInteger i = 0; i < workerCount; i++)
+        [workQueues addObject:[NSMutableArray array]];
+    
+    //Spread the starting directories across the workers
+    [startPaths enumerateObjectsUsingBlock:^(NSString *path, NSUInteger idx, BOOL *stop) {
+        TOSMBSessionTreeWalkerItem *item = [[TOSMBSessionTreeWalkerItem alloc] init];
+        item.path = path;
+        item.depth = 0;
+        [workQueues[idx % workerCount] addObject:item];
+    }];
+    
+    [self.workCondition lock];
+    self.workQueues = workQueues;
+    self.pendingDirectoryCount = startPaths.count;
+    [self.workCondition unlock];
+    
+    //Run each worker on its own thread, as they spend most of their time blocked on the network
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t workerQueue = dispatch_queue_create("com.timoliver.tosmbclient.treewalker.workers", DISPATCH_QUEUE_CONCURRENT);
+    for (NSUInteger i = 0; i < workerCount; i++) {
+        dispatch_group_async(group, workerQueue, ^{
+            [self runWorkerAtIndex:i];
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    
+    //Let any remaining results be delivered before reporting completion
+    dispatch_sync(self.filesQueue, ^{});
+    
+    self.running = NO;
+    
+    NSError *error = self.firstError;
+    NSOperationQueue *delegateQueue = self.session.delegateQueue ?: [NSOperationQueue mainQueue];
+    [delegateQueue addOperationWithBlock:^{
+        if (self.completionHandler)
+            self.completionHandler(error);
+    }];
+}
+
+- (void)runWorkerAtIndex:(NSUInteger)index
+{
+    //Each worker lists directories over its own logged-in connection.
+    //If one can't connect, the others will take over the directories in its queue.
+    NSError *error = nil;
+    TOSMBConnection *connection = [self.session dequeueConnectionWithError:&error];
+    if (connection == nil) {
+        [self recordError:error];
+        return;
+    }
+    
+    TOSMBSessionTreeWalkerItem *item = nil;
+    while ((item = [self nextItemForWorkerAtIndex:index])) {
+        @autoreleasepool {
+            [self listDirectoryForItem:item workerIndex:index connection:connection];
+        }
+        
+        [self.workCondition lock];
+        self.pendingDirectoryCount--;
+        if (self.pendingDirectoryCount == 0)
+            [self.workCondition broadcast];
+        [self.workCondition unlock];
+    }
+    
+    [self.session enqueueConnection:connection];
+}
+
+- (TOSMBSessionTreeWalkerItem *)nextItemForWorkerAtIndex:(NSUInteger)index
+{
+    TOSMBSessionTreeWalkerItem *item = nil;
+    NSUInteger queueCount = self.workQueues.count;
+    
+    [self.workCondition lock];
+    while (item == nil && self.cancelled == NO && self.pendingDirectoryCount > 0) {
+        //Take the newest directory from our own queue, to stay close to what we just listed
+        NSMutableArray *queue = self.workQueues[index];
+        item = queue.lastObject;
+        if (item) {
+            [queue removeLastObject];
+            break;
+        }
+        
+        //Otherwise take the oldest directory from someone else's queue, which is likely to have the most beneath it
+        for (NSUInteger i = 1; i < queueCount && item == nil; i++) {
+            NSMutableArray *otherQueue = self.workQueues[(index + i) % queueCount];
+            item = otherQueue.firstObject;
+            if (item)
+                [otherQueue removeObjectAtIndex:0];
+        }
+        
+        //Nothing is available yet, so wait for a busy worker to discover more directories, or for the walk to end
+        if (item == nil)
+            [self.workCondition wait];
+    }
+    [self.workCondition unlock];
+    
+    return item;
+}
+
+- (void)listDirectoryForItem:(TOSMBSessionTreeWalkerItem *)item workerIndex:(NSUInteger)index connection:(TOSMBConnection *)connection
+{
+    TOSMBSession *session = self.session;
+    if (session == nil)
+        return;
+    
+    BOOL (^includeHandler)(TOSMBSessionFile *) = self.includeHandler;
+    BOOL (^descendHandler)(TOSMBSessionFile *) = self.descendHandler;
+    BOOL canDescend = (item.depth < self.maximumDepth);
+    
+    NSMutableArray *files = [NSMutableArray array];
+    NSMutableArray *subdirectories = [NSMutableArray array];
+    
+    NSError *error = [session enumerateStatsOfDirectoryAtFilePath:item.path connection:connection usingBlock:^(smb_stat stat, BOOL *stop) {
+        if (self.cancelled) {
+            *stop = YES;
+            return;
+        }
+        
+        TOSMBSessionFile *file = [[TOSMBSessionFile alloc] initWithStat:stat session:session parentDirectoryFilePath:item.path];
+        if (includeHandler == nil || includeHandler(file))
+            [files addObject:file];
+        
+        if (file.directory && canDescend && (descendHandler == nil || descendHandler(file))) {
+            TOSMBSessionTreeWalkerItem *subdirectory = [[TOSMBSessionTreeWalkerItem alloc] init];
+            subdirectory.path = file.filePath;
+            subdirectory.depth = item.depth + 1;
+            [subdirectories addObject:subdirectory];
+        }
+    }];
+    
+    [self recordError:error];
+    
+    [self.workCondition lock];
+    self.directoryCount++;
+    self.fileCount += files.count;
+    if (subdirectories.count > 0 && self.cancelled == NO) {
+        [self.workQueues[index] addObjectsFromArray:subdirectories];
+        self.pendingDirectoryCount += subdirectories.count;
+        [self.workCondition broadcast];
+    }
+    [self.workCondition unlock];
+    
+    //Stream the results of this directory out straight away
+    void (^filesHandler)(NSArray *) = self.filesHandler;
+    if (files.count == 0 || filesHandler == nil || self.cancelled)
+        return;
+    
+    dispatch_semaphore_t pendingBatches = self.pendingBatches;
+    dispatch_semaphore_wait(pendingBatches, DISPATCH_TIME_FOREVER);
+    dispatch_async(self.filesQueue, ^{
+        filesHandler(files);
+        dispatch_semaphore_signal(pendingBatches);
+    });
+}
+
+- (void)recordError:(NSError *)error
+{
+    if (error == nil)
+        return;
+    
+    [self.workCondition lock];
+    if (self.firstError == nil)
+        self.firstError = error;
+    [self.workCondition unlock];
+}
+
+@end
@@ -34,8 +34,76 @@
     totalBytesSent:(uint64_t)totalBytesSent
 totalBytesExpectedToSend:(uint64_t)totalBytesExpectedToSend;
 
+/**
+ Delegate event that is called when an upload that was previously interrupted carries on from
+ the data that had already been sent, rather than starting again.
+ 
+ @param uploadTask The upload task object calling this delegate method.
+ @param byteOffset The byte offset at which the upload resumed.
+ @param totalBytesExpectedToSend The number of bytes expected to be sent for this entire file.
+ */
+- (void)uploadTask:(TOSMBSessionUploadTask *)uploadTask
+ didResumeAtOffset:(uint64_t)byteOffset
+totalBytesExpectedToSend:(uint64_t)totalBytesExpectedToSend;
+
+/**
+ Delegate event that is called each time a segment of a segmented upload has been completely sent.
+ 
+ @param uploadTask The upload task object calling this delegate method.
+ @param offset The byte offset of the segment in the file.
+ @param length The number of bytes in the segment.
+ @param bytesPerSecond The rate at which the segment was sent over its connection.
+ */
+- (void)uploadTask:(TOSMBSessionUploadTask *)uploadTask
+didSendSegmentAtOffset:(uint64_t)offset
+            length:(uint64_t)length
+    bytesPerSecond:(double)bytesPerSecond;
+
 @end
 
 @interface TOSMBSessionUploadTask : TOSMBSessionTask
 
+/** For tasks uploading a local file, the path of that file. */
+@property (nonatomic, readonly, copy) NSString *sourceFilePath;
+
+/** The number of bytes presently uploaded by this task */
+@property (readonly) int64_t countOfBytesSent;
+
+/** The total number of bytes we expect to upload. 0 for streams of unknown length, until they have been read to the end. */
+@property (readonly) int64_t countOfBytesExpectedToSend;
+
+/**
+ Uploads the file to a hidden temporary file in the same directory, and only renames it to the destination
+ once it has been completely written, so other clients never see a partially uploaded file. If the upload
+ fails or is cancelled, including when it can't be renamed into place, the temporary file is deleted.
+ 
+ Any existing file at the destination is replaced. As SMB renames can't replace a file, the existing file is
+ first renamed aside, and only deleted once the new file is in place (Or renamed back if that fails). For the
+ brief moment between those two renames, nothing exists at the destination path.
+ (Default is NO)
+ */
+@property (nonatomic, assign) BOOL usesTemporaryFile;
+
+/** The number of connections used to upload separate segments of the file in parallel.
+ Files smaller than two segments, and uploads from input streams, always use a single connection. Default: 1. */
+@property (nonatomic, assign) NSUInteger maximumConnectionCount;
+
+/** The size, in bytes, of each segment when uploading over multiple connections.
+ The segments that have been completely sent are remembered, so a resumed upload only sends the rest. Default: 4 MB. */
+@property (nonatomic, assign) uint64_t segmentSize;
+
+/**
+ Resumed uploads carry on from the end of the file already on the device. By default, this only happens
+ when the task itself was interrupted. Set this to also carry on from a file left by an earlier task
+ (eg, before the app was relaunched). Uploads from input streams can't be resumed this way.
+ */
+@property (nonatomic, assign) BOOL resumesExistingFile;
+
+/**
+ Before resuming, up to this many bytes at the end of the file on the device are read back and compared
+ against the source. If they differ, the upload starts again from the beginning. 0 skips the check.
+ (Default is 64 KB)
+ */
+@property (nonatomic, assign) NSUInteger resumeVerificationLength;
+
 @end
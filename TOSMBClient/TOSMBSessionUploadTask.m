@@ -20,19 +20,60 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 // -------------------------------------------------------------------------------
 
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
 #import "TOSMBSessionUploadTaskPrivate.h"
 #import "TOSMBSessionPrivate.h"
+#import "TOSMBBufferPool.h"
+#import "TOSMBChunkSizer.h"
 
 @interface TOSMBSessionUploadTask ()
 
 @property (nonatomic, copy) NSString *path;
 @property (nonatomic, copy) NSData *data;
+@property (nonatomic, copy, readwrite) NSString *sourceFilePath;
+@property (nonatomic, strong) NSInputStream *inputStream;
+@property (nonatomic, assign) int sourceFileDescriptor;
+@property (nonatomic, assign) uint64_t sourceBytesConsumed; /* How far into the input stream we've read */
+
+/* The segments of a segmented upload that have been completely written, kept between runs so a resumed upload only sends the rest */
+@property (nonatomic, strong) NSMutableIndexSet *completedSegments;
+@property (nonatomic, assign) uint64_t completedSegmentSize;  /* The segment size, and file size, the completed segments were measured with */
+@property (nonatomic, assign) uint64_t completedSegmentFileSize;
 
 @property (nonatomic, strong) TOSMBSessionFile *file;
 
 @property (nonatomic, weak) id <TOSMBSessionUploadTaskDelegate> delegate;
 @property (nonatomic, copy) void (^successHandler)(void);
 
+@property (assign, readwrite) int64_t countOfBytesSent;
+@property (assign, readwrite) int64_t countOfBytesExpectedToSend;
+
+/* Reading the source in chunks */
+- (NSError *)openSource;
+- (void)closeSource;
+- (ssize_t)readSourceAtOffset:(uint64_t)offset intoBuffer:(char *)buffer length:(size_t)length bytes:(const char **)bytes;
+
+/* Atomic uploads */
+@property (nonatomic, readonly) NSString *temporaryPath;
+@property (nonatomic, readonly) NSString *backupPath;
+- (NSString *)formattedPathForPath:(NSString *)path;
+- (void)removeTemporaryFile:(NSString *)temporaryPath inTree:(smb_tid)treeID fileID:(smb_fd *)fileID;
+
+/* Resuming */
+- (BOOL)recreateFile:(NSString *)path inTree:(smb_tid)treeID fileID:(smb_fd *)fileID;
+- (BOOL)verifyFile:(smb_fd)fileID matchesSourceBeforeOffset:(uint64_t)offset;
+- (void)didResumeAtOffset:(uint64_t)bytesSent totalBytesExpected:(uint64_t)totalBytesExpected;
+
+/* Segmented uploading over multiple connections */
+- (BOOL)uploadSegmentsWithOperation:(__weak NSBlockOperation *)weakOperation
+                             treeID:(smb_tid)treeID
+                             fileID:(smb_fd *)fileID
+                      formattedPath:(NSString *)formattedPath;
+- (void)didSendSegmentAtOffset:(uint64_t)offset length:(uint64_t)length duration:(NSTimeInterval)duration;
+
 @end
 
 @implementation TOSMBSessionUploadTask
@@ -45,6 +86,12 @@
     if ((self = [super initWithSession:session])) {
         self.path = path;
         self.data = data;
+        self.countOfBytesExpectedToSend = data.length;
+        self.sourceFileDescriptor = -1;
+        self.resumeVerificationLength = 65536;
+        self.maximumConnectionCount = 1;
+        self.segmentSize = 4 * 1024 * 1024;
+        self.completedSegments = [NSMutableIndexSet indexSet];
     }
     
     return self;
@@ -76,30 +123,267 @@
     return self;
 }
 
+- (instancetype)initWithSession:(TOSMBSession *)session
+                           path:(NSString *)path
+                 sourceFilePath:(NSString *)sourceFilePath
+                progressHandler:(id)progressHandler
+                 successHandler:(id)successHandler
+                    failHandler:(id)failHandler {
+    if ((self = [self initWithSession:session path:path data:nil progressHandler:progressHandler successHandler:successHandler failHandler:failHandler])) {
+        self.sourceFilePath = sourceFilePath;
+        
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:sourceFilePath error:nil];
+        self.countOfBytesExpectedToSend = (int64_t)[attributes fileSize];
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithSession:(TOSMBSession *)session
+                           path:(NSString *)path
+                    inputStream:(NSInputStream *)inputStream
+                         length:(int64_t)length
+                progressHandler:(id)progressHandler
+                 successHandler:(id)successHandler
+                    failHandler:(id)failHandler {
+    if ((self = [self initWithSession:session path:path data:nil progressHandler:progressHandler successHandler:successHandler failHandler:failHandler])) {
+        self.inputStream = inputStream;
+        self.countOfBytesExpectedToSend = MAX(length, 0);
+    }
+    
+    return self;
+}
+
+#pragma mark - source
+
+- (NSError *)openSource {
+    if (self.sourceFilePath) {
+        self.sourceFileDescriptor = open(self.sourceFilePath.fileSystemRepresentation, O_RDONLY);
+        if (self.sourceFileDescriptor < 0) {
+            return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+        }
+        
+        //The file may have changed since the task was created
+        struct stat fileStat;
+        if (fstat(self.sourceFileDescriptor, &fileStat) == 0) {
+            self.countOfBytesExpectedToSend = fileStat.st_size;
+        }
+        
+        //The file is only read once, front to back
+        fcntl(self.sourceFileDescriptor, F_RDAHEAD, 1);
+        fcntl(self.sourceFileDescriptor, F_NOCACHE, 1);
+    }
+    else if (self.inputStream) {
+        if (self.inputStream.streamStatus == NSStreamStatusNotOpen) {
+            [self.inputStream open];
+        }
+        if (self.inputStream.streamStatus == NSStreamStatusError) {
+            return errorForErrorCode(TOSMBSessionErrorCodeFileNotFound);
+        }
+    }
+    
+    return nil;
+}
+
+- (void)closeSource {
+    if (self.sourceFileDescriptor >= 0) {
+        close(self.sourceFileDescriptor);
+        self.sourceFileDescriptor = -1;
+    }
+    
+    //Streams are left open while suspended, so the upload can carry on from the same place
+    if (self.state != TOSMBSessionTaskStateSuspended) {
+        [self.inputStream close];
+    }
+}
+
+- (ssize_t)readSourceAtOffset:(uint64_t)offset intoBuffer:(char *)buffer length:(size_t)length bytes:(const char **)bytes {
+    //Data is written straight out of the data object, rather than being copied
+    if (self.data) {
+        if (offset >= self.data.length) {
+            return 0;
+        }
+        *bytes = (const char *)self.data.bytes + offset;
+        return (ssize_t)MIN((uint64_t)length, self.data.length - offset);
+    }
+    
+    //Files and streams are read in chunks into the buffer, so only one chunk is ever held in memory.
+    //Keep reading until the chunk is full, so each write is as large as it can be.
+    *bytes = buffer;
+    size_t bytesRead = 0;
+    while (bytesRead < length) {
+        ssize_t result = 0;
+        if (self.sourceFileDescriptor >= 0) {
+            result = pread(self.sourceFileDescriptor, buffer + bytesRead, length - bytesRead, (off_t)(offset + bytesRead));
+        }
+        else if (self.inputStream) {
+            result = [self.inputStream read:(uint8_t *)buffer + bytesRead maxLength:length - bytesRead];
+            if (result > 0) {
+                self.sourceBytesConsumed += result;
+            }
+        }
+        
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+    
+    return (ssize_t)bytesRead;
+}
+
+#pragma mark - atomic uploads
+
+- (NSString *)temporaryPath {
+    //Hidden, and in the same directory, so it can be renamed into place without moving any data
+    NSString *fileName = [NSString stringWithFormat:@".%@.tosmbupload", self.path.lastPathComponent];
+    return [[self.path stringByDeletingLastPathComponent] stringByAppendingPathComponent:fileName];
+}
+
+- (NSString *)backupPath {
+    //Where the file being replaced is kept until the new one has been renamed into its place
+    NSString *fileName = [NSString stringWithFormat:@".%@.tosmbbackup", self.path.lastPathComponent];
+    return [[self.path stringByDeletingLastPathComponent] stringByAppendingPathComponent:fileName];
+}
+
+- (NSString *)formattedPathForPath:(NSString *)path {
+    NSString *formattedPath = [self.session filePathExcludingSharePathFromPath:path];
+    formattedPath = [NSString stringWithFormat:@"\\%@",formattedPath];
+    return [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+}
+
+- (void)removeTemporaryFile:(NSString *)temporaryPath inTree:(smb_tid)treeID fileID:(smb_fd *)fileID {
+    if (temporaryPath == nil || self.smbSession == NULL) {
+        return;
+    }
+    
+    //The file has to be closed before the device will delete it
+    if (*fileID) {
+        smb_fclose(self.smbSession, *fileID);
+        *fileID = 0;
+    }
+    
+    smb_file_rm(self.smbSession, treeID, [temporaryPath cStringUsingEncoding:NSUTF8StringEncoding]);
+}
+
+#pragma mark - resuming
+
+- (BOOL)recreateFile:(NSString *)path inTree:(smb_tid)treeID fileID:(smb_fd *)fileID {
+    //The file has to be closed before the device will delete it
+    if (*fileID) {
+        smb_fclose(self.smbSession, *fileID);
+        *fileID = 0;
+    }
+    
+    const char *filePath = [path cStringUsingEncoding:NSUTF8StringEncoding];
+    smb_file_rm(self.smbSession, treeID, filePath);
+    smb_fopen(self.smbSession, treeID, filePath, SMB_MOD_RW, fileID);
+    self.file = nil;
+    
+    return (*fileID != 0);
+}
+
+- (BOOL)canBeResumed {
+    //Streams can't be rewound, so they can only ever carry on from where they were left
+    if (self.inputStream) {
+        return self.sourceBytesConsumed > 0;
+    }
+    
+    return (self.countOfBytesSent > 0 || self.resumesExistingFile);
+}
+
+- (BOOL)verifyFile:(smb_fd)fileID matchesSourceBeforeOffset:(uint64_t)offset {
+    TOSMBBufferPool *bufferPool = self.session.bufferPool;
+    size_t length = (size_t)MIN(MIN((uint64_t)self.resumeVerificationLength, offset), (uint64_t)bufferPool.bufferSize);
+    if (length == 0) {
+        return YES;
+    }
+    
+    char *remoteBuffer = [bufferPool dequeueBuffer];
+    char *sourceBuffer = (self.data == nil) ? [bufferPool dequeueBuffer] : NULL;
+    BOOL matches = NO;
+    
+    if (remoteBuffer && (self.data || sourceBuffer)) {
+        uint64_t startOffset = offset - length;
+        
+        //Read back the end of what's already on the device
+        size_t remoteLength = 0;
+        smb_fseek(self.smbSession, fileID, (off_t)startOffset, SMB_SEEK_SET);
+        while (remoteLength < length) {
+            ssize_t bytesRead = smb_fread(self.smbSession, fileID, remoteBuffer + remoteLength, length - remoteLength);
+            if (bytesRead <= 0) {
+                break;
+            }
+            remoteLength += bytesRead;
+        }
+        
+        const char *sourceBytes = NULL;
+        ssize_t sourceLength = [self readSourceAtOffset:startOffset intoBuffer:sourceBuffer length:length bytes:&sourceBytes];
+        
+        matches = (remoteLength == length && sourceLength == (ssize_t)length && memcmp(remoteBuffer, sourceBytes, length) == 0);
+    }
+    
+    if (remoteBuffer) {
+        [bufferPool enqueueBuffer:remoteBuffer];
+    }
+    if (sourceBuffer) {
+        [bufferPool enqueueBuffer:sourceBuffer];
+    }
+    
+    return matches;
+}
+
 #pragma mark - delegate helpers
 
-- (void)didSendBytes:(NSInteger)recentCount bytesSent:(NSInteger)totalCount {
+- (uint64_t)progressBytesCompleted {
+    return self.countOfBytesSent;
+}
+
+- (uint64_t)progressBytesExpected {
+    return self.countOfBytesExpectedToSend;
+}
+
+- (void)deliverProgressWithBytes:(uint64_t)bytes totalBytes:(uint64_t)totalBytes totalBytesExpected:(uint64_t)totalBytesExpected {
+    if ([self.delegate respondsToSelector:@selector(uploadTask:didSendBytes:totalBytesSent:totalBytesExpectedToSend:)]) {
+        [self.delegate uploadTask:self didSendBytes:bytes totalBytesSent:totalBytes totalBytesExpectedToSend:totalBytesExpected];
+    }
+    if (self.progressHandler) {
+        self.progressHandler(totalBytes, totalBytesExpected);
+    }
+}
+
+- (void)didResumeAtOffset:(uint64_t)bytesSent totalBytesExpected:(uint64_t)totalBytesExpected {
     __weak typeof(self) weakSelf = self;
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([weakSelf.delegate respondsToSelector:@selector(uploadTask:didSendBytes:totalBytesSent:totalBytesExpectedToSend:)]) {
-            [weakSelf.delegate uploadTask:self didSendBytes:recentCount totalBytesSent:totalCount totalBytesExpectedToSend:weakSelf.data.length];
+    [self performDelegateBlock:^{
+        if ([weakSelf.delegate respondsToSelector:@selector(uploadTask:didResumeAtOffset:totalBytesExpectedToSend:)]) {
+            [weakSelf.delegate uploadTask:weakSelf didResumeAtOffset:bytesSent totalBytesExpectedToSend:totalBytesExpected];
         }
-        if (weakSelf.progressHandler) {
-            weakSelf.progressHandler(totalCount, weakSelf.data.length);
+    }];
+}
+
+- (void)didSendSegmentAtOffset:(uint64_t)offset length:(uint64_t)length duration:(NSTimeInterval)duration {
+    double bytesPerSecond = (duration > 0) ? (double)length / duration : 0.0;
+    __weak typeof(self) weakSelf = self;
+    [self performDelegateBlock:^{
+        if ([weakSelf.delegate respondsToSelector:@selector(uploadTask:didSendSegmentAtOffset:length:bytesPerSecond:)]) {
+            [weakSelf.delegate uploadTask:weakSelf didSendSegmentAtOffset:offset length:length bytesPerSecond:bytesPerSecond];
         }
-    });
+    }];
 }
 
 - (void)didFinish {
     __weak typeof(self) weakSelf = self;
-    dispatch_async(dispatch_get_main_queue(), ^{
+    [self performDelegateBlock:^{
         if ([weakSelf.delegate respondsToSelector:@selector(uploadTaskDidFinishUploading:)]) {
             [weakSelf.delegate uploadTaskDidFinishUploading:self];
         }
         if (weakSelf.successHandler) {
             weakSelf.successHandler();
         }
-    });
+    }];
 }
 
 #pragma mark - task
@@ -114,14 +398,10 @@
     //---------------------------------------------------------------------------------------
     //Connect to SMB device
     
-    self.smbSession = smb_session_new();
-    
-    //First, check to make sure the server is there, and to acquire its attributes
-    __block NSError *error = nil;
-    dispatch_sync(self.session.serialQueue, ^{
-        error = [self.session attemptConnectionWithSessionPointer:self.smbSession];
-    });
-    if (error) {
+    //Borrow a logged-in connection from the session, or connect and log in if none are available
+    NSError *error = nil;
+    self.connection = [self.session dequeueConnectionWithError:&error];
+    if (self.connection == nil) {
         [self didFailWithError:error];
         self.cleanupBlock(treeID, fileID);
         return;
@@ -135,12 +415,11 @@
     //---------------------------------------------------------------------------------------
     //Connect to share
     
-    //Next attach to the share we'll be using
+    //Next attach to the share we'll be using (This is a no-op if the pooled connection already did)
     NSString *shareName = [self.session shareNameFromPath:self.path];
-    const char *shareCString = [shareName cStringUsingEncoding:NSUTF8StringEncoding];
-    
-    if (smb_tree_connect(self.smbSession, shareCString, &treeID) != 0) {
-        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeShareConnectionFailed)];
+    error = [self.connection connectToShareWithName:shareName treeID:&treeID];
+    if (error) {
+        [self didFailWithError:error];
         self.cleanupBlock(treeID, fileID);
         return;
     }
@@ -153,12 +432,13 @@
     //---------------------------------------------------------------------------------------
     //Find the target file
     
-    NSString *formattedPath = [self.session filePathExcludingSharePathFromPath:self.path];
-    formattedPath = [NSString stringWithFormat:@"\\%@",formattedPath];
-    formattedPath = [formattedPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\\\"];
+    NSString *formattedPath = [self formattedPathForPath:self.path];
     
     //Get the file info we'll be working off
-    self.file = [self requestFileForItemAtPath:formattedPath inTree:treeID];
+    [self.connection performOnShareWithName:shareName treeID:&treeID usingBlock:^BOOL(smb_tid shareTreeID) {
+        self.file = [self requestFileForItemAtPath:formattedPath inTree:shareTreeID];
+        return (self.file != nil);
+    }];
     
     if (weakOperation.isCancelled) {
         self.cleanupBlock(treeID, fileID);
@@ -171,10 +451,24 @@
         return;
     }
     
+    //Atomic uploads are written to a temporary file beside the destination, which is only renamed once it's complete
+    NSString *temporaryPath = nil;
+    if (self.usesTemporaryFile) {
+        temporaryPath = [self formattedPathForPath:self.temporaryPath];
+        self.file = [self requestFileForItemAtPath:temporaryPath inTree:treeID];
+        
+        //Anything left over from an upload we aren't carrying on from has to go, or it could outlast the new data
+        if (self.file && self.canBeResumed == NO) {
+            smb_file_rm(self.smbSession, treeID, [temporaryPath cStringUsingEncoding:NSUTF8StringEncoding]);
+            self.file = nil;
+        }
+    }
+    
     //---------------------------------------------------------------------------------------
     //Open the file handle
     
-    smb_fopen(self.smbSession, treeID, [formattedPath cStringUsingEncoding:NSUTF8StringEncoding], SMB_MOD_RW, &fileID);
+    NSString *writePath = temporaryPath ?: formattedPath;
+    smb_fopen(self.smbSession, treeID, [writePath cStringUsingEncoding:NSUTF8StringEncoding], SMB_MOD_RW, &fileID);
     if (!fileID) {
         [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileNotFound)];
         self.cleanupBlock(treeID, fileID);
@@ -186,35 +480,388 @@
         return;
     }
     
-    NSUInteger bufferSize = self.data.length;
-    void *buffer = malloc(bufferSize);
-    [self.data getBytes:buffer length:bufferSize];
-    // change the limit size to 63488(62KB)
-    // (if still crash, change the limit size < 63488)
-    size_t uploadBufferLimit = MIN(bufferSize, 63488);
+    error = [self openSource];
+    if (error) {
+        [self fail];
+        [self didFailWithError:error];
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
+    //Files and streams are read through a single pooled buffer, so memory use doesn't grow with the size of the upload
+    TOSMBBufferPool *bufferPool = self.session.bufferPool;
+    char *buffer = (self.data == nil) ? [bufferPool dequeueBuffer] : NULL;
+    size_t bufferSize = (self.data == nil) ? bufferPool.bufferSize : SIZE_MAX;
+    TOSMBChunkSizer *chunkSizer = self.session.writeChunkSizer;
+    
+    uint64_t totalBytesWritten = 0;
+    BOOL failed = (self.data == nil && buffer == NULL);
+    
+    //Large files can be split into segments, and uploaded over several connections at once.
+    //Once they're all sent, the loop below finds nothing left to read and goes straight on to finishing up.
+    uint64_t segmentSize = MAX(self.segmentSize, 65536);
+    BOOL segmented = (failed == NO && self.maximumConnectionCount > 1 && self.inputStream == nil &&
+                      (uint64_t)self.countOfBytesExpectedToSend >= segmentSize * 2);
+    if (segmented) {
+        failed = ([self uploadSegmentsWithOperation:weakOperation treeID:treeID fileID:&fileID formattedPath:writePath] == NO);
+        totalBytesWritten = self.countOfBytesSent;
+    }
+    
+    //If this upload was interrupted, carry on from however much of it made it to the device
+    if (segmented == NO && failed == NO && self.canBeResumed) {
+        uint64_t remoteFileSize = self.file ? self.file.fileSize : 0;
+        if (self.inputStream) {
+            //Everything read from the stream so far has to be there already, since it can't be read again
+            totalBytesWritten = self.sourceBytesConsumed;
+            failed = (remoteFileSize < totalBytesWritten);
+        }
+        else {
+            //If the end of what's there doesn't match the source, it came from somewhere else, so start again
+            totalBytesWritten = MIN(remoteFileSize, (uint64_t)self.countOfBytesExpectedToSend);
+            if (totalBytesWritten > 0 && [self verifyFile:fileID matchesSourceBeforeOffset:totalBytesWritten] == NO) {
+                totalBytesWritten = 0;
+            }
+        }
+    }
     
-    ssize_t bytesWritten = 0;
-    ssize_t totalBytesWritten = 0;
+    //Existing files aren't truncated when they're opened, so unless we're carrying on from what's already there,
+    //a file with anything in it has to be replaced with an empty one. The same goes for one that would outlast the source.
+    if (segmented == NO && failed == NO) {
+        uint64_t remoteFileSize = self.file ? self.file.fileSize : 0;
+        uint64_t expectedSize = (uint64_t)self.countOfBytesExpectedToSend;
+        BOOL outlastsSource = (self.inputStream == nil || expectedSize > 0) && remoteFileSize > expectedSize;
+        if (remoteFileSize > 0 && (totalBytesWritten == 0 || outlastsSource)) {
+            //What's been read from a stream can't be read again, so it can't start over
+            if (self.inputStream && totalBytesWritten > 0) {
+                failed = YES;
+            }
+            else {
+                totalBytesWritten = 0;
+                failed = ([self recreateFile:writePath inTree:treeID fileID:&fileID] == NO);
+            }
+        }
+    }
     
-    do {
-        // change the the size of last part
-        if (bufferSize - totalBytesWritten < uploadBufferLimit) {
-            uploadBufferLimit = bufferSize - totalBytesWritten;
+    if (segmented == NO) {
+        self.countOfBytesSent = totalBytesWritten;
+        self.progressBytesDelivered = totalBytesWritten;
+        smb_fseek(self.smbSession, fileID, (off_t)totalBytesWritten, SMB_SEEK_SET);
+        
+        if (failed == NO && totalBytesWritten > 0) {
+            [self didResumeAtOffset:totalBytesWritten totalBytesExpected:self.countOfBytesExpectedToSend];
+            [self didUpdateProgress];
         }
-        bytesWritten = smb_fwrite(self.smbSession, fileID, buffer+totalBytesWritten, uploadBufferLimit);
-        if (bytesWritten < 0) {
+    }
+    
+    while (failed == NO && weakOperation.isCancelled == NO) {
+        //Size each write to suit the current network conditions
+        size_t uploadBufferLimit = MIN(chunkSizer.chunkSize, bufferSize);
+        
+        const char *bytes = NULL;
+        ssize_t bytesToWrite = [self readSourceAtOffset:totalBytesWritten intoBuffer:buffer length:uploadBufferLimit bytes:&bytes];
+        if (bytesToWrite < 0) {
+            failed = YES;
+            break;
+        }
+        if (bytesToWrite == 0) {
+            break;
+        }
+        
+        //A chunk may take several writes if the server accepts less than all of it
+        ssize_t chunkBytesWritten = 0;
+        while (chunkBytesWritten < bytesToWrite) {
+            size_t writeLength = (size_t)(bytesToWrite - chunkBytesWritten);
+            CFAbsoluteTime writeStartTime = CFAbsoluteTimeGetCurrent();
+            ssize_t bytesWritten = smb_fwrite(self.smbSession, fileID, (void *)(bytes + chunkBytesWritten), writeLength);
+            if (bytesWritten <= 0) {
+                self.connection.invalid = (bytesWritten < 0);
+                failed = YES;
+                break;
+            }
+            
+            [chunkSizer recordTransferOfBytes:(size_t)bytesWritten
+                               requestedBytes:writeLength
+                                     duration:CFAbsoluteTimeGetCurrent() - writeStartTime
+                                    endOfFile:(bytesToWrite < (ssize_t)uploadBufferLimit)];
+            
+            chunkBytesWritten += bytesWritten;
+            totalBytesWritten += bytesWritten;
+            self.countOfBytesSent = totalBytesWritten;
+            [self didUpdateProgress];
+        }
+    }
+    
+    [self closeSource];
+    if (buffer) {
+        [bufferPool enqueueBuffer:buffer];
+    }
+    
+    if (failed) {
+        [self fail];
+        [self removeTemporaryFile:temporaryPath inTree:treeID fileID:&fileID];
+        [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
+    if (weakOperation.isCancelled) {
+        //Suspended uploads keep their temporary file to carry on from
+        if (self.state == TOSMBSessionTaskStateCancelled) {
+            [self removeTemporaryFile:temporaryPath inTree:treeID fileID:&fileID];
+        }
+        self.cleanupBlock(treeID, fileID);
+        return;
+    }
+    
+    //Streams of unknown length only find out how long they were at the end
+    if (self.countOfBytesExpectedToSend != (int64_t)totalBytesWritten) {
+        self.countOfBytesExpectedToSend = totalBytesWritten;
+        [self didUpdateProgress];
+    }
+    
+    //Move the finished file into place. SMB renames won't replace an existing file, so any older copy is renamed
+    //out of the way first, and only deleted once the new file has taken its place.
+    if (temporaryPath) {
+        smb_fclose(self.smbSession, fileID);
+        fileID = 0;
+        
+        const char *destinationPath = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+        const char *backupPath = NULL;
+        BOOL moved = NO;
+        if ([self requestFileForItemAtPath:formattedPath inTree:treeID]) {
+            NSString *formattedBackupPath = [self formattedPathForPath:self.backupPath];
+            backupPath = [formattedBackupPath cStringUsingEncoding:NSUTF8StringEncoding];
+            
+            //A copy left behind by an earlier upload that didn't get to finish would block the rename
+            if ([self requestFileForItemAtPath:formattedBackupPath inTree:treeID]) {
+                smb_file_rm(self.smbSession, treeID, backupPath);
+            }
+            
+            if (smb_file_mv(self.smbSession, treeID, destinationPath, backupPath) != 0) {
+                backupPath = NULL;
+            }
+            else {
+                moved = (smb_file_mv(self.smbSession, treeID, [temporaryPath cStringUsingEncoding:NSUTF8StringEncoding], destinationPath) == 0);
+                
+                //Put the old copy back where it was, rather than leaving nothing at the destination
+                if (moved == NO) {
+                    smb_file_mv(self.smbSession, treeID, backupPath, destinationPath);
+                }
+            }
+        }
+        else {
+            moved = (smb_file_mv(self.smbSession, treeID, [temporaryPath cStringUsingEncoding:NSUTF8StringEncoding], destinationPath) == 0);
+        }
+        
+        //Don't leave the temporary file behind. Any older copy has already been put back at the destination.
+        if (moved == NO) {
+            [self removeTemporaryFile:temporaryPath inTree:treeID fileID:&fileID];
             [self fail];
             [self didFailWithError:errorForErrorCode(TOSMBSessionErrorCodeFileDownloadFailed)];
-            break;
+            self.cleanupBlock(treeID, fileID);
+            return;
+        }
+        
+        if (backupPath) {
+            smb_file_rm(self.smbSession, treeID, backupPath);
         }
-        totalBytesWritten += bytesWritten;
-        [self didSendBytes:bytesWritten bytesSent:totalBytesWritten];
-    } while (totalBytesWritten < bufferSize);
+    }
     
-    free(buffer);
+    //Make sure the next listing of this folder picks up the new file
+    [self.session invalidateCachedContentsOfDirectoryAtFilePath:[self.path stringByDeletingLastPathComponent]];
     
     [self didFinish];
+    
+    //Close the file and return the connection to the pool
+    self.cleanupBlock(treeID, fileID);
 }
 
 
+#pragma mark - segmented uploading
+
+- (BOOL)uploadSegmentsWithOperation:(__weak NSBlockOperation *)weakOperation
+                             treeID:(smb_tid)treeID
+                             fileID:(smb_fd *)fileID
+                      formattedPath:(NSString *)formattedPath {
+    uint64_t fileSize = (uint64_t)self.countOfBytesExpectedToSend;
+    uint64_t segmentSize = MAX(self.segmentSize, 65536);
+    NSUInteger segmentCount = (NSUInteger)((fileSize + segmentSize - 1) / segmentSize);
+    uint64_t remoteFileSize = self.file ? self.file.fileSize : 0;
+    
+    //Segments finished by an earlier run only count if they were measured the same way, and the file on the device is still the size they were written into
+    if (self.canBeResumed == NO || self.completedSegmentSize != segmentSize ||
+        self.completedSegmentFileSize != fileSize || remoteFileSize != fileSize) {
+        [self.completedSegments removeAllIndexes];
+    }
+    
+    //Existing files aren't truncated when they're opened, so if we aren't carrying on from one that would outlast the source, it's replaced with an empty one
+    if (self.completedSegments.count == 0 && remoteFileSize > fileSize) {
+        if ([self recreateFile:formattedPath inTree:treeID fileID:fileID] == NO) {
+            return NO;
+        }
+        remoteFileSize = 0;
+    }
+    self.completedSegmentSize = segmentSize;
+    self.completedSegmentFileSize = fileSize;
+    
+    //Size the file on the device up front by writing its last byte, so segments can be written into it in any order
+    if (remoteFileSize < fileSize) {
+        char lastByte = 0;
+        const char *bytes = NULL;
+        if ([self readSourceAtOffset:fileSize - 1 intoBuffer:&lastByte length:1 bytes:&bytes] != 1) {
+            return NO;
+        }
+        
+        smb_fseek(self.smbSession, *fileID, (off_t)(fileSize - 1), SMB_SEEK_SET);
+        if (smb_fwrite(self.smbSession, *fileID, (void *)bytes, 1) != 1) {
+            self.connection.invalid = YES;
+            return NO;
+        }
+    }
+    
+    uint64_t resumedBytes = 0;
+    NSUInteger index = self.completedSegments.firstIndex;
+    while (index != NSNotFound) {
+        resumedBytes += MIN(segmentSize, fileSize - (index * segmentSize));
+        index = [self.completedSegments indexGreaterThanIndex:index];
+    }
+    
+    self.countOfBytesSent = resumedBytes;
+    self.progressBytesDelivered = resumedBytes;
+    if (resumedBytes > 0) {
+        [self didResumeAtOffset:resumedBytes totalBytesExpected:fileSize];
+    }
+    
+    NSString *shareName = [self.session shareNameFromPath:self.path];
+    const char *filePath = [formattedPath cStringUsingEncoding:NSUTF8StringEncoding];
+    
+    NSUInteger workerCount = MIN(self.maximumConnectionCount, segmentCount);
+    NSLock *lock = [[NSLock alloc] init];
+    __block NSUInteger nextSegment = 0;
+    __block BOOL failed = NO;
+    
+    //Each worker keeps taking the next unsent segment until there are none left.
+    //The first worker uses the task's own connection, and the rest borrow connections from the session's pool.
+    [self performWithWorkerCount:workerCount usingBlock:^(NSUInteger worker) {
+        TOSMBConnection *connection = self.connection;
+        smb_fd workerFileID = (worker == 0) ? *fileID : 0;
+        
+        if (worker > 0) {
+            smb_tid workerTreeID = 0;
+            connection = [self.session dequeueConnectionWithError:nil];
+            if (connection == nil) {
+                return;
+            }
+            
+            if ([connection connectToShareWithName:shareName treeID:&workerTreeID] == nil) {
+                smb_fopen(connection.session, workerTreeID, filePath, SMB_MOD_RW, &workerFileID);
+            }
+            
+            if (!workerFileID) {
+                [self.session enqueueConnection:connection];
+                return;
+            }
+        }
+        
+        //Data uploads are written straight out of the data object, so only files need a buffer to read into
+        TOSMBBufferPool *bufferPool = self.session.bufferPool;
+        TOSMBChunkSizer *chunkSizer = self.session.writeChunkSizer;
+        char *buffer = (self.data == nil) ? [bufferPool dequeueBuffer] : NULL;
+        if (self.data == nil && buffer == NULL) {
+            [lock lock];
+            failed = YES;
+            [lock unlock];
+        }
+        
+        while (weakOperation.isCancelled == NO) {
+            //Claim the next segment that hasn't been sent yet
+            [lock lock];
+            NSUInteger segment = nextSegment;
+            while (segment < segmentCount && [self.completedSegments containsIndex:segment]) {
+                segment++;
+            }
+            nextSegment = segment + 1;
+            BOOL stop = failed;
+            [lock unlock];
+            
+            if (segment >= segmentCount || stop) {
+                break;
+            }
+            
+            //Segments are only marked as done once they've been sent in full, so an interrupted one is sent again from its start
+            uint64_t segmentStart = segment * segmentSize;
+            uint64_t segmentEnd = MIN(segmentStart + segmentSize, fileSize);
+            uint64_t offset = segmentStart;
+            CFAbsoluteTime segmentStartTime = CFAbsoluteTimeGetCurrent();
+            
+            smb_fseek(connection.session, workerFileID, (off_t)offset, SMB_SEEK_SET);
+            
+            while (offset < segmentEnd && weakOperation.isCancelled == NO) {
+                size_t chunkSize = (size_t)MIN((uint64_t)MIN(chunkSizer.chunkSize, bufferPool.bufferSize), segmentEnd - offset);
+                
+                const char *bytes = NULL;
+                ssize_t bytesToWrite = [self readSourceAtOffset:offset intoBuffer:buffer length:chunkSize bytes:&bytes];
+                
+                CFAbsoluteTime writeStartTime = CFAbsoluteTimeGetCurrent();
+                ssize_t bytesWritten = (bytesToWrite > 0) ? smb_fwrite(connection.session, workerFileID, (void *)bytes, (size_t)bytesToWrite) : -1;
+                if (bytesWritten > 0) {
+                    [chunkSizer recordTransferOfBytes:(size_t)bytesWritten
+                                       requestedBytes:(size_t)bytesToWrite
+                                             duration:CFAbsoluteTimeGetCurrent() - writeStartTime
+                                            endOfFile:(offset + bytesWritten >= fileSize)];
+                }
+                
+                if (bytesWritten <= 0) {
+                    if (bytesToWrite > 0) {
+                        connection.invalid = (bytesWritten < 0);
+                    }
+                    
+                    [lock lock];
+                    failed = YES;
+                    [lock unlock];
+                    break;
+                }
+                
+                offset += bytesWritten;
+                
+                @synchronized (self) {
+                    self.countOfBytesSent += bytesWritten;
+                }
+                
+                [self didUpdateProgress];
+            }
+            
+            if (offset < segmentEnd) {
+                //Take back the bytes of the unfinished segment, as it will be sent again in full
+                @synchronized (self) {
+                    self.countOfBytesSent -= (offset - segmentStart);
+                }
+                break;
+            }
+            
+            [lock lock];
+            [self.completedSegments addIndex:segment];
+            [lock unlock];
+            
+            [self didSendSegmentAtOffset:segmentStart length:segmentEnd - segmentStart duration:CFAbsoluteTimeGetCurrent() - segmentStartTime];
+        }
+        
+        if (buffer) {
+            [bufferPool enqueueBuffer:buffer];
+        }
+        
+        if (worker > 0) {
+            smb_fclose(connection.session, workerFileID);
+            [self.session enqueueConnection:connection];
+        }
+    }];
+    
+    if (weakOperation.isCancelled) {
+        return YES;
+    }
+    
+    //Make sure every segment was actually sent (eg, in case none of the extra connections could be made)
+    return (failed == NO && self.completedSegments.count == segmentCount);
+}
+
 @end
@@ -41,6 +41,23 @@
                  successHandler:(id)successHandler
                     failHandler:(id)failHandler;
 
+/* Reads the file in chunks as it is uploaded, rather than loading all of it into memory */
+- (instancetype)initWithSession:(TOSMBSession *)session
+                           path:(NSString *)path
+                 sourceFilePath:(NSString *)sourceFilePath
+                progressHandler:(id)progressHandler
+                 successHandler:(id)successHandler
+                    failHandler:(id)failHandler;
+
+/* Reads the stream in chunks as it is uploaded. A length of 0 means the length isn't known up front. */
+- (instancetype)initWithSession:(TOSMBSession *)session
+                           path:(NSString *)path
+                    inputStream:(NSInputStream *)inputStream
+                         length:(int64_t)length
+                progressHandler:(id)progressHandler
+                 successHandler:(id)successHandler
+                    failHandler:(id)failHandler;
+
 @end
 
 #endif /* TOSMBSessionUploadTaskPrivate_h */
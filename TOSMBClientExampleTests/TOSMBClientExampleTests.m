@@ -8,6 +8,12 @@
 
 #import <UIKit/UIKit.h>
 #import <XCTest/XCTest.h>
+#import "TOSMBClient.h"
+#import "TOSMBSessionFilePrivate.h"
+#import "TOSMBSessionDirectoryListingPrivate.h"
+#import "TOSMBSessionFileFilterPrivate.h"
+#import "TOSMBChunkSizer.h"
+#import "TOSMBSessionDownloadTaskPrivate.h"
 
 @interface TOSMBClientExampleTests : XCTestCase
 
@@ -30,6 +36,306 @@
     XCTAssert(YES, @"Pass");
 }
 
+// FILETIME counts 100-nanosecond intervals from 1601-01-01 UTC.
+- (void)testDateFromFileTime {
+    XCTAssertEqual([TOSMBDateFromFileTime(0) timeIntervalSince1970], -11644473600.0);
+    XCTAssertEqual([TOSMBDateFromFileTime(116444736000000000ULL) timeIntervalSince1970], 0.0);
+    XCTAssertEqualWithAccuracy([TOSMBDateFromFileTime(116444736000000000ULL + 15000000ULL) timeIntervalSince1970], 1.5, 0.0001);
+}
+
+// Compact listings have to come out in the same order as the object listings, which sort with -compare:.
+- (void)testDirectoryListingSortsLikeCompare {
+    NSArray<NSString *> *names = @[@"b", @"B", @"a10", @"a2", @"\u00c4pfel", @"Zebra", @"\u00e9t\u00e9", @"a"];
+    
+    TOSMBSessionDirectoryListing *listing = [[TOSMBSessionDirectoryListing alloc] initWithSession:nil directoryPath:@"/"];
+    for (NSString *name in names)
+        XCTAssertTrue([listing appendShareName:name.UTF8String]);
+    [listing sortByName];
+    
+    NSArray<NSString *> *expectedNames = [names sortedArrayUsingSelector:@selector(compare:)];
+    XCTAssertEqual(listing.count, expectedNames.count);
+    for (NSUInteger i = 0; i < expectedNames.count; i++)
+        XCTAssertEqualObjects([listing nameAtIndex:i], expectedNames[i]);
+}
+
+// Size limits only apply to files, and the modified-since date is compared against raw FILETIME values.
+- (void)testFileFilterMatching {
+    TOSMBSessionFileFilter *filter = [TOSMBSessionFileFilter filterWithPattern:nil];
+    XCTAssertEqualObjects(filter.searchPattern, @"*");
+    XCTAssertTrue([filter matchesFileSize:0 directory:NO modificationTimestamp:0]);
+    
+    filter.pattern = @"*.mkv";
+    filter.minimumFileSize = 100;
+    filter.maximumFileSize = 200;
+    XCTAssertEqualObjects(filter.searchPattern, @"*.mkv");
+    XCTAssertFalse([filter matchesFileSize:99 directory:NO modificationTimestamp:0]);
+    XCTAssertTrue([filter matchesFileSize:100 directory:NO modificationTimestamp:0]);
+    XCTAssertTrue([filter matchesFileSize:200 directory:NO modificationTimestamp:0]);
+    XCTAssertFalse([filter matchesFileSize:201 directory:NO modificationTimestamp:0]);
+    XCTAssertTrue([filter matchesFileSize:0 directory:YES modificationTimestamp:0]);
+    
+    //The Unix epoch, as a FILETIME value
+    uint64_t epochTimestamp = 116444736000000000ULL;
+    filter.modifiedSinceDate = [NSDate dateWithTimeIntervalSince1970:0];
+    XCTAssertFalse([filter matchesFileSize:150 directory:NO modificationTimestamp:epochTimestamp - 1]);
+    XCTAssertTrue([filter matchesFileSize:150 directory:NO modificationTimestamp:epochTimestamp]);
+    
+    filter.directoriesOnly = YES;
+    XCTAssertFalse([filter matchesFileSize:150 directory:NO modificationTimestamp:epochTimestamp]);
+    XCTAssertTrue([filter matchesFileSize:0 directory:YES modificationTimestamp:epochTimestamp]);
+    
+    //Copies are taken when a listing starts, so they have to carry every condition across
+    TOSMBSessionFileFilter *copiedFilter = [filter copy];
+    XCTAssertFalse([copiedFilter matchesFileSize:150 directory:NO modificationTimestamp:epochTimestamp]);
+    XCTAssertFalse([copiedFilter matchesFileSize:0 directory:YES modificationTimestamp:epochTimestamp - 1]);
+}
+
+// The chunk size steps in whichever direction improves throughput, and never goes past the largest size the device accepts.
+- (void)testChunkSizerStepsAndCapsAfterShortRead {
+    TOSMBChunkSizer *chunkSizer = [[TOSMBChunkSizer alloc] initWithMinimumChunkSize:4096 maximumChunkSize:65536];
+    XCTAssertEqual(chunkSizer.chunkSize, 65536);
+    
+    //Slow calls step the size down, and it keeps going down while that helps
+    [chunkSizer recordTransferOfBytes:65536 requestedBytes:65536 duration:1.0 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 32768);
+    [chunkSizer recordTransferOfBytes:32768 requestedBytes:32768 duration:0.25 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 16384);
+    
+    //Once throughput drops it turns around, and holds when the difference is within the noise
+    [chunkSizer recordTransferOfBytes:16384 requestedBytes:16384 duration:0.25 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 32768);
+    [chunkSizer recordTransferOfBytes:32768 requestedBytes:32768 duration:0.25 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 65536);
+    [chunkSizer recordTransferOfBytes:65536 requestedBytes:65536 duration:0.5 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 65536);
+    [chunkSizer recordTransferOfBytes:65536 requestedBytes:65536 duration:0.25 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 65536);
+    
+    //A short read at the end of the file is expected, and doesn't lower the limit
+    [chunkSizer recordTransferOfBytes:100 requestedBytes:65536 duration:0.001 endOfFile:YES];
+    XCTAssertEqual(chunkSizer.maximumChunkSize, 65536);
+    
+    //Anywhere else, it caps every later size at what the device returned
+    [chunkSizer recordTransferOfBytes:20000 requestedBytes:65536 duration:0.001 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.maximumChunkSize, 20000);
+    XCTAssertEqual(chunkSizer.chunkSize, 20000);
+    for (NSUInteger i = 0; i < 64; i++)
+        [chunkSizer recordTransferOfBytes:20000 requestedBytes:20000 duration:0.0001 endOfFile:NO];
+    XCTAssertEqual(chunkSizer.chunkSize, 20000);
+    
+    //A fixed size is still kept within the limit
+    chunkSizer.preferredChunkSize = 8192;
+    XCTAssertEqual(chunkSizer.chunkSize, 8192);
+    chunkSizer.preferredChunkSize = 1024 * 1024;
+    XCTAssertEqual(chunkSizer.chunkSize, 20000);
+}
+
+// Ranges are clipped to the file. Downloads to a file merge them, and downloads to memory keep them as they were asked for.
+- (void)testByteRangesAreClippedAndMerged {
+    NSArray<NSValue *> *ranges = @[[NSValue valueWithRange:NSMakeRange(100, 50)],
+                                   [NSValue valueWithRange:NSMakeRange(0, 10)],
+                                   [NSValue valueWithRange:NSMakeRange(120, 100)],
+                                   [NSValue valueWithRange:NSMakeRange(5, 3)],
+                                   [NSValue valueWithRange:NSMakeRange(10, 5)],
+                                   [NSValue valueWithRange:NSMakeRange(990, 50)],
+                                   [NSValue valueWithRange:NSMakeRange(2000, 10)]];
+    TOSMBSession *session = [[TOSMBSession alloc] initWithIPAddress:@"127.0.0.1"];
+    
+    TOSMBSessionDownloadTask *fileTask = [session downloadTaskForByteRanges:ranges ofFileAtPath:@"/Share/file.bin" destinationPath:NSTemporaryDirectory()
+                                                             progressHandler:nil completionHandler:nil failHandler:nil];
+    NSArray<NSValue *> *expectedFileRanges = @[[NSValue valueWithRange:NSMakeRange(0, 15)],
+                                               [NSValue valueWithRange:NSMakeRange(100, 120)],
+                                               [NSValue valueWithRange:NSMakeRange(990, 10)]];
+    XCTAssertEqualObjects([fileTask rangesToFetchForFileSize:1000], expectedFileRanges);
+    
+    TOSMBSessionDownloadTask *memoryTask = [session downloadTaskForByteRanges:ranges ofFileAtPath:@"/Share/file.bin"
+                                                               progressHandler:nil completionHandler:nil failHandler:nil];
+    NSArray<NSValue *> *expectedMemoryRanges = @[[NSValue valueWithRange:NSMakeRange(100, 50)],
+                                                 [NSValue valueWithRange:NSMakeRange(0, 10)],
+                                                 [NSValue valueWithRange:NSMakeRange(120, 100)],
+                                                 [NSValue valueWithRange:NSMakeRange(5, 3)],
+                                                 [NSValue valueWithRange:NSMakeRange(10, 5)],
+                                                 [NSValue valueWithRange:NSMakeRange(990, 10)],
+                                                 [NSValue valueWithRange:NSMakeRange(1000, 0)]];
+    XCTAssertEqualObjects([memoryTask rangesToFetchForFileSize:1000], expectedMemoryRanges);
+}
+
+// Compares download throughput with and without overlapping network reads and disk writes.
+// Only runs when pointed at a file on a local share, eg TOSMB_BENCHMARK_HOST=192.168.1.2 TOSMB_BENCHMARK_FILE=/Share/large.mkv
+- (void)testDownloadPipelineThroughput {
+    NSDictionary *environment = [NSProcessInfo processInfo].environment;
+    NSString *host = environment[@"TOSMB_BENCHMARK_HOST"];
+    NSString *filePath = environment[@"TOSMB_BENCHMARK_FILE"];
+    if (host.length == 0 || filePath.length == 0)
+        XCTSkip(@"Set TOSMB_BENCHMARK_HOST and TOSMB_BENCHMARK_FILE to run this benchmark");
+    
+    TOSMBSession *session = [[TOSMBSession alloc] initWithIPAddress:host];
+    [session setLoginCredentialsWithUserName:environment[@"TOSMB_BENCHMARK_USER"] password:environment[@"TOSMB_BENCHMARK_PASSWORD"]];
+    
+    NSString *destinationPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [[NSFileManager defaultManager] createDirectoryAtPath:destinationPath withIntermediateDirectories:YES attributes:nil error:nil];
+    
+    for (NSNumber *bufferCount in @[@1, @4]) {
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Download"];
+        __block uint64_t fileSize = 0;
+        
+        TOSMBSessionDownloadTask *task = [session downloadTaskForFileAtPath:filePath destinationPath:destinationPath progressHandler:^(uint64_t totalBytesWritten, uint64_t totalBytesExpected) {
+            fileSize = totalBytesExpected;
+        } completionHandler:^(NSString *downloadedPath) {
+            [[NSFileManager defaultManager] removeItemAtPath:downloadedPath error:nil];
+            [expectation fulfill];
+        } failHandler:^(NSError *error) {
+            XCTFail(@"%@", error);
+            [expectation fulfill];
+        }];
+        task.pipelineBufferCount = bufferCount.unsignedIntegerValue;
+        
+        //Make sure each run starts from nothing, rather than resuming or skipping a file left by the last one
+        [[NSFileManager defaultManager] removeItemAtPath:[task valueForKey:@"tempFilePath"] error:nil];
+        
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        [task resume];
+        [self waitForExpectationsWithTimeout:600 handler:nil];
+        NSTimeInterval duration = CFAbsoluteTimeGetCurrent() - startTime;
+        
+        [[NSFileManager defaultManager] removeItemAtPath:[task valueForKey:@"tempFilePath"] error:nil];
+        XCTAssertGreaterThan(fileSize, 0);
+        NSLog(@"Buffers: %@, %.2f MB/s", bufferCount, (fileSize / (1024.0 * 1024.0)) / duration);
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+}
+
+// Compares the files per second of one download task per file against a single batch download task.
+// Only runs when pointed at a directory of small files on a local share, eg TOSMB_BENCHMARK_HOST=192.168.1.2 TOSMB_BENCHMARK_DIRECTORY=/Share/Photos
+- (void)testBatchDownloadThroughput {
+    NSDictionary *environment = [NSProcessInfo processInfo].environment;
+    NSString *host = environment[@"TOSMB_BENCHMARK_HOST"];
+    NSString *directoryPath = environment[@"TOSMB_BENCHMARK_DIRECTORY"];
+    if (host.length == 0 || directoryPath.length == 0)
+        XCTSkip(@"Set TOSMB_BENCHMARK_HOST and TOSMB_BENCHMARK_DIRECTORY to run this benchmark");
+
+    TOSMBSession *session = [[TOSMBSession alloc] initWithIPAddress:host];
+    [session setLoginCredentialsWithUserName:environment[@"TOSMB_BENCHMARK_USER"] password:environment[@"TOSMB_BENCHMARK_PASSWORD"]];
+
+    NSError *error = nil;
+    NSMutableArray *filePaths = [NSMutableArray array];
+    for (TOSMBSessionFile *file in [session requestContentsOfDirectoryAtFilePath:directoryPath error:&error]) {
+        if (file.directory == NO)
+            [filePaths addObject:file.filePath];
+    }
+    XCTAssertNil(error);
+    if (filePaths.count == 0)
+        XCTSkip(@"%@ has no files to download", directoryPath);
+
+    //One task per file
+    NSString *destinationPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [[NSFileManager defaultManager] createDirectoryAtPath:destinationPath withIntermediateDirectories:YES attributes:nil error:nil];
+    XCTestExpectation *tasksExpectation = [self expectationWithDescription:@"Tasks"];
+    __block NSUInteger remainingCount = filePaths.count;
+    void (^finishFile)(void) = ^{
+        if (--remainingCount == 0)
+            [tasksExpectation fulfill];
+    };
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for (NSString *filePath in filePaths) {
+        [[session downloadTaskForFileAtPath:filePath destinationPath:destinationPath progressHandler:nil completionHandler:^(NSString *downloadedPath) {
+            finishFile();
+        } failHandler:^(NSError *error) {
+            finishFile();
+        }] resume];
+    }
+    [self waitForExpectationsWithTimeout:600 handler:nil];
+    NSLog(@"Tasks: %.1f files/s", filePaths.count / (CFAbsoluteTimeGetCurrent() - startTime));
+    [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+
+    //One batch for every file
+    XCTestExpectation *batchExpectation = [self expectationWithDescription:@"Batch"];
+    TOSMBSessionBatchDownloadTask *batchTask = [session batchDownloadTaskForFilesAtPaths:filePaths destinationPath:destinationPath progressHandler:nil completionHandler:^{
+        [batchExpectation fulfill];
+    } failHandler:^(NSError *error) {
+        XCTFail(@"%@", error);
+        [batchExpectation fulfill];
+    }];
+    [batchTask resume];
+    [self waitForExpectationsWithTimeout:600 handler:nil];
+    NSLog(@"Batch: %.1f files/s", batchTask.filesPerSecond);
+    [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+}
+
+// Stops a download partway through, leaves the partial file looking like the app was killed mid-write, then resumes it.
+// Only runs when pointed at a file on a local share, eg TOSMB_BENCHMARK_HOST=192.168.1.2 TOSMB_BENCHMARK_FILE=/Share/large.mkv
+- (void)testDownloadResumesFromCheckpointAfterInterruption {
+    NSDictionary *environment = [NSProcessInfo processInfo].environment;
+    NSString *host = environment[@"TOSMB_BENCHMARK_HOST"];
+    NSString *filePath = environment[@"TOSMB_BENCHMARK_FILE"];
+    if (host.length == 0 || filePath.length == 0)
+        XCTSkip(@"Set TOSMB_BENCHMARK_HOST and TOSMB_BENCHMARK_FILE to run this test");
+    
+    TOSMBSession *session = [[TOSMBSession alloc] initWithIPAddress:host];
+    [session setLoginCredentialsWithUserName:environment[@"TOSMB_BENCHMARK_USER"] password:environment[@"TOSMB_BENCHMARK_PASSWORD"]];
+    
+    NSString *destinationPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [[NSFileManager defaultManager] createDirectoryAtPath:destinationPath withIntermediateDirectories:YES attributes:nil error:nil];
+    
+    //Download part of the file, flushing often so there's a checkpoint to come back to
+    XCTestExpectation *suspendExpectation = [self expectationWithDescription:@"Suspend"];
+    __block TOSMBSessionDownloadTask *task = nil;
+    __block uint64_t fileSize = 0;
+    task = [session downloadTaskForFileAtPath:filePath destinationPath:destinationPath progressHandler:^(uint64_t totalBytesWritten, uint64_t totalBytesExpected) {
+        if (fileSize > 0 || totalBytesWritten < totalBytesExpected / 3)
+            return;
+        
+        fileSize = totalBytesExpected;
+        [task suspend];
+        [suspendExpectation fulfill];
+    } completionHandler:^(NSString *downloadedPath) {
+        XCTFail(@"The file finished downloading before it could be interrupted");
+        [suspendExpectation fulfill];
+    } failHandler:^(NSError *error) {
+        XCTFail(@"%@", error);
+        [suspendExpectation fulfill];
+    }];
+    task.durability = TOSMBSessionDownloadDurabilityPeriodic;
+    task.synchronizationByteInterval = 1024 * 1024;
+    [task resume];
+    [self waitForExpectationsWithTimeout:600 handler:nil];
+    [session.taskQueue waitUntilAllOperationsAreFinished];
+    
+    //A killed app leaves unflushed bytes at the end of the file and never gets to set its modification date
+    NSString *tempFilePath = [task valueForKey:@"tempFilePath"];
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:tempFilePath];
+    XCTAssertNotNil(fileHandle);
+    [fileHandle seekToEndOfFile];
+    [fileHandle writeData:[NSMutableData dataWithLength:4096]];
+    [fileHandle closeFile];
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate:[NSDate date]} ofItemAtPath:tempFilePath error:nil];
+    
+    //A fresh task for the same file should pick up from the checkpoint and discard the rest
+    XCTestExpectation *resumeExpectation = [self expectationWithDescription:@"Resume"];
+    __block uint64_t firstBytesWritten = 0;
+    __block NSString *finalPath = nil;
+    TOSMBSessionDownloadTask *resumedTask = [session downloadTaskForFileAtPath:filePath destinationPath:destinationPath progressHandler:^(uint64_t totalBytesWritten, uint64_t totalBytesExpected) {
+        if (firstBytesWritten == 0)
+            firstBytesWritten = totalBytesWritten;
+    } completionHandler:^(NSString *downloadedPath) {
+        finalPath = downloadedPath;
+        [resumeExpectation fulfill];
+    } failHandler:^(NSError *error) {
+        XCTFail(@"%@", error);
+        [resumeExpectation fulfill];
+    }];
+    XCTAssertTrue(resumedTask.canBeResumed);
+    [resumedTask resume];
+    [self waitForExpectationsWithTimeout:600 handler:nil];
+    
+    XCTAssertGreaterThan(firstBytesWritten, 0);
+    XCTAssertLessThan(firstBytesWritten, fileSize);
+    XCTAssertEqual([[[NSFileManager defaultManager] attributesOfItemAtPath:finalPath error:nil] fileSize], fileSize);
+    [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+}
+
 - (void)testPerformanceExample {
     // This is an example of a performance test case.
     [self measureBlock:^{